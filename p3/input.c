@@ -1,44 +1,213 @@
 /**
     @file input.c
     @author Stephen Gonsalves (dkgonsal)
-    
-    The input file uses the readLine() function to read in the next line from the
-    input file. If the line is longer than the received capacity, it prints an 
-    error message to stderr and exits with a status of 1.
+
+    The input file gives match the lines of its input file. A regular file is
+    mapped into memory and lines are found in place, so they can be any
+    length and are never copied. Input that can't be mapped, like a pipe, is
+    read in large blocks instead, with a line that runs past the end of one
+    block carried over to the next.
   */
 
+// For mmap(), memrchr() and friends, which -std=c99 hides
+#define _GNU_SOURCE
+
 #include "input.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-/** The readLine() method validates a received stream, copied into a char array
-    and determines its validity based on the defined capacity. It returns a boolean
-    response based on validity.
-    
-    @param *fp is the received file stream to read in.
-    @param line is the char array for storing each char of the string.
-    @param capacity is the max allowable capacity of the read input.
-    @return It returns true if the line is valid. Otherwise, returns false.
+/** The readBlock() function reads the next block of input that can't be
+    mapped. The part of a line left over from the last block is moved to the
+    front first, and the space for it grows if one line won't fit.
+
+    @param in is the input being read.
+    @return true if there was more to read. Otherwise, returns false.
   */
-bool readLine( FILE *fp, char line[], int capacity ) 
+static bool readBlock( Input *in )
 {
-  int len = 0;
+  in->len -= in->pos;
+  memmove( in->data, in->data + in->pos, in->len );
+  in->pos = 0;
 
-  // Get/test first char and continue reading until newline char
-  char ch = fgetc( fp );
-  if ( ch == EOF ) {
+  if ( in->len + BLOCK_SIZE > in->cap ) {
+    in->cap *= 2;
+    in->data = ( char * ) realloc( in->data, in->cap );
+  }
+
+  ssize_t n = read( in->fd, in->data + in->len, in->cap - in->len );
+  if ( n <= 0 ) {
+    in->failed = n < 0;
+    close( in->fd );
+    in->fd = -1;
     return false;
-  } 
-  
-  // 
-  while ( ch != '\n' ) {
-    if ( len < capacity ) {
-      line[ len++ ] = ch; 
-    } else if ( len == capacity ){
-      fprintf( stderr, "Line too long\n");
-      exit( 1 );
+  }
+  in->len += n;
+  return true;
+}
+
+/** The openInput() function opens a file and gets its contents ready to be
+    read a line at a time.
+
+    @param fileName is the name of the file.
+    @return the input, or NULL if the file can't be opened or read.
+  */
+Input *openInput( char const *fileName )
+{
+  int fd = open( fileName, O_RDONLY );
+  if ( fd < 0 ) {
+    return NULL;
+  }
+
+  Input *in = ( Input * ) malloc( sizeof( Input ) );
+  in->data = NULL;
+  in->len = 0;
+  in->mapped = false;
+  in->pos = 0;
+  in->fd = -1;
+  in->cap = 0;
+  in->failed = false;
+
+  // An empty file can't be mapped, but there's nothing to read either
+  struct stat st;
+  if ( fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 ) {
+    void *data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( data != MAP_FAILED ) {
+      posix_madvise( data, st.st_size, POSIX_MADV_SEQUENTIAL );
+      in->data = ( char * ) data;
+      in->len = st.st_size;
+      in->mapped = true;
+      close( fd );
+      return in;
     }
-    ch = fgetc( fp );
   }
 
-  line [ len ] = '\0';
+  // Anything else is read a block at a time as its lines are wanted, so
+  // only the block and one line are ever held
+  in->fd = fd;
+  in->cap = 2 * BLOCK_SIZE;
+  in->data = ( char * ) malloc( in->cap );
+  if ( !readBlock( in ) && in->failed ) {
+    closeInput( in );
+    return NULL;
+  }
+  return in;
+}
+
+/** The readLine() function finds the next line of the input. The line isn't
+    copied or terminated, so it's only good until the next line is read. A
+    last line with no newline after it still counts.
+
+    @param in is the input being read.
+    @param line is where a pointer to the start of the line is stored.
+    @param len is where the number of bytes in the line is stored, not
+           counting the newline.
+    @return true if there was another line. Otherwise, returns false.
+  */
+bool readLine( Input *in, char const **line, long *len )
+{
+  if ( in->pos >= in->len && in->fd < 0 ) {
+    return false;
+  }
+
+  // Only the bytes read since the last search need looking at
+  long from = in->pos;
+  char const *end = memchr( in->data + from, '\n', in->len - from );
+  while ( !end && in->fd >= 0 ) {
+    from = in->len - in->pos;
+    if ( readBlock( in ) ) {
+      end = memchr( in->data + from, '\n', in->len - from );
+    }
+  }
+
+  if ( !end ) {
+    if ( in->pos >= in->len ) {
+      return false;
+    }
+    end = in->data + in->len;
+  }
+
+  *line = in->data + in->pos;
+  *len = end - *line;
+  in->pos += *len + 1;
   return true;
-}
\ No newline at end of file
+}
+
+/** The readLineBefore() function finds the line that ends just before a
+    point in the input, for reading it backward. Like readLine(), the line
+    isn't copied or terminated. Only a mapped input can be read backward.
+
+    @param in is the input being read.
+    @param end is where the line after it starts, or the length of the
+           input for the last line. It's moved back to the start of the line.
+    @param line is where a pointer to the start of the line is stored.
+    @param len is where the number of bytes in the line is stored, not
+           counting the newline.
+    @return true if there was a line before end. Otherwise, returns false.
+  */
+bool readLineBefore( Input *in, long *end, char const **line, long *len )
+{
+  if ( *end <= 0 ) {
+    return false;
+  }
+
+  // Only the last line can be missing its newline
+  long stop = *end;
+  if ( in->data[ stop - 1 ] == '\n' ) {
+    stop--;
+  }
+
+  char const *start = memrchr( in->data, '\n', stop );
+  start = start ? start + 1 : in->data;
+
+  *line = start;
+  *len = in->data + stop - start;
+  *end = start - in->data;
+  return true;
+}
+
+/** The countLines() function counts the lines that start before a point in
+    a mapped input.
+
+    @param in is the input being read.
+    @param end is the point in the input.
+    @return the number of lines.
+  */
+long countLines( Input const *in, long end )
+{
+  long count = 0;
+  char const *pos = in->data;
+  char const *stop = in->data + end;
+  while ( pos < stop ) {
+    pos = memchr( pos, '\n', stop - pos );
+    if ( !pos ) {
+      break;
+    }
+    pos++;
+    count++;
+  }
+
+  // A last line with no newline after it still counts
+  if ( end > 0 && in->data[ end - 1 ] != '\n' ) {
+    count++;
+  }
+  return count;
+}
+
+/** The closeInput() function frees an input and unmaps or closes its file.
+
+    @param in is the input being closed.
+  */
+void closeInput( Input *in )
+{
+  if ( in->mapped ) {
+    munmap( in->data, in->len );
+  } else {
+    free( in->data );
+  }
+  if ( in->fd >= 0 ) {
+    close( in->fd );
+  }
+  free( in );
+}
@@ -3,6 +3,30 @@
 #include <string.h>
 #include <stdbool.h>
 
-#define MAX_LINE_LEN 1024
+/** Number of bytes read at a time from input that can't be mapped */
+#define BLOCK_SIZE ( 1024 * 1024 )
 
-bool readLine( FILE *fp, char line[], int capacity);
+/** The contents of an input file, split into lines as they're read. */
+typedef struct {
+  /** Bytes of the file if it's mapped, or else the block last read with any
+      line left over from the one before. */
+  char *data;
+  /** Number of bytes in data. */
+  long len;
+  /** True if data is mapped from the file rather than read into memory. */
+  bool mapped;
+  /** Where the next line starts. */
+  long pos;
+  /** File still being read a block at a time, or -1 once it's all read. */
+  int fd;
+  /** Number of bytes data has room for when it isn't mapped. */
+  long cap;
+  /** True if reading the file failed before the end. */
+  bool failed;
+} Input;
+
+Input *openInput( char const *fileName );
+bool readLine( Input *in, char const **line, long *len );
+bool readLineBefore( Input *in, long *end, char const **line, long *len );
+long countLines( Input const *in, long end );
+void closeInput( Input *in );
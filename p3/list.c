@@ -2,8 +2,9 @@
     @file list.c
     @author Stephen Gonsalves (dkgonsal)
     
-    The list file handles the functions of adding to the list of matching lines
-    and printing that list out when each respective function is called by match.c.
+    The list file prints the matching lines as match.c finds them. Lines are
+    collected in a large buffer and written out together, so no matter how
+    many lines match, only the buffer is held in memory.
   */
 
 #include "list.h"
@@ -14,72 +15,108 @@
 /** Limit of line printed if line # is included */
 #define DIGITS 10
 
-/** Current index in the matchList array */
-int idx = 0;
+/** Output waiting to be written */
+static char outBuffer[ OUTPUT_BUFFER_SIZE ];
 
-/** Array that holds the line numbers of matches */
-int lineNum[ MAX_FILE_LINES ];
+/** Number of bytes in outBuffer */
+static int outLen = 0;
 
-/** Array that holds the list of matches */
-char matchList[ MAX_FILE_LINES ][ INPUT_LIMIT + 1 ];
+/** True if line numbers are printed with the lines */
+static bool numbers = false;
 
-/** The addLine() function adds a line of matching text to the matchList array.
-    It also adds the line number of the matching text to the lineNum array.
-     
-    @param lno is the line number of the matching text.
-    @param line is the string of matching text.
+/** Number of digits the line numbers are printed in */
+static int width = 0;
+
+/** Smallest line number too long to fit in width */
+static long widthLimit = 1;
+
+/** The flushOutput() function writes out the buffered output.
   */
-void addLine( int lno, char const line[] ) 
+static void flushOutput( void )
 {
-  // Check if we've reach 1000 matched lines
-  if ( idx == MAX_FILE_LINES + 1 ) {
-    fprintf( stderr, "Too many matches\n");
-    exit ( 1 );
-  }
+  fwrite( outBuffer, 1, outLen, stdout );
+  outLen = 0;
+}
+
+/** The putOutput() function adds bytes to the buffered output, writing it
+    out first if they won't fit.
 
-  // Add the lno and line to their arrays
-  lineNum[ idx ] = lno;
-  strcpy( matchList[idx], line);
-  idx++;
+    @param data is the bytes being added.
+    @param len is the number of bytes.
+  */
+static void putOutput( char const data[], long len )
+{
+  if ( outLen + len > OUTPUT_BUFFER_SIZE ) {
+    flushOutput();
+    if ( len > OUTPUT_BUFFER_SIZE ) {
+      fwrite( data, 1, len, stdout );
+      return;
+    }
+  }
+  memcpy( outBuffer + outLen, data, len );
+  outLen += len;
 }
 
-/** The printList() function is responsible for printing the list of matches. It 
-    receives a boolean variable as its parameter, which determines if the line
-    numbers will be printed as well. If true, the matchList lines will have to be
-    altered to facilitate an 80 character or less requirement for printout.
-    
+/** The startList() function gets ready to print the matching lines. The line
+    numbers are all as wide as the last one printed, so it should be known
+    before any line is added. If it isn't, each number is printed as wide as
+    the widest one so far.
+
     @param numberFlag dictates line number inclusion in the printout. If false, line
            numbers will not be printed.
+    @param lastLno is the number of the last line that will be added, or 0
+           if it isn't known.
   */
-void printList( bool numberFlag )
+void startList( bool numberFlag, long lastLno )
 {
-  int max = lineNum[ idx - 1 ];
+  numbers = numberFlag;
 
   // Find number of digits
-  int count = 0;
-  int n = 0;
-  while (max != 0) {
-    n = max % DIGITS;
-    max = max - n;
-    max = max / DIGITS;
-    count++;
+  width = 0;
+  widthLimit = 1;
+  while ( lastLno >= widthLimit ) {
+    widthLimit *= DIGITS;
+    width++;
   }
-  max = count;
-
-  int prIdx = 0;
-  while ( idx > prIdx ) {  
-    if ( numberFlag ) {
-      printf( "%*d ", max, lineNum[prIdx] ); 
-      if ( strlen(matchList[prIdx]) >= OUTPUT_LIMIT - max ) {
-        printf("%.*s..\n", PRINT_LIMIT - (max + 1), matchList[prIdx]);
-      } else {
-        printf( "%s\n", matchList[prIdx] );
-      }
-    } else if ( strlen(matchList[prIdx]) > OUTPUT_LIMIT ) {
-      printf("%.*s..\n", PRINT_LIMIT, matchList[prIdx]);
+}
+
+/** The addLine() function prints a line of matching text, with its line number
+    if startList() was asked for them. Lines too long for the 80 character
+    output are cut short and end with two dots.
+
+    @param lno is the line number of the matching text.
+    @param line is the matching text, which needn't be terminated.
+    @param len is the number of characters in the line.
+  */
+void addLine( long lno, char const line[], long len )
+{
+  if ( numbers ) {
+    while ( lno >= widthLimit ) {
+      widthLimit *= DIGITS;
+      width++;
+    }
+
+    char num[ DIGITS * 3 ];
+    putOutput( num, snprintf( num, sizeof( num ), "%*ld ", width, lno ) );
+    if ( len >= OUTPUT_LIMIT - width ) {
+      putOutput( line, PRINT_LIMIT - ( width + 1 ) );
+      putOutput( "..", 2 );
     } else {
-      printf( "%s\n", matchList[prIdx] );
+      putOutput( line, len );
     }
-    prIdx++;
+  } else if ( len > OUTPUT_LIMIT ) {
+    putOutput( line, PRINT_LIMIT );
+    putOutput( "..", 2 );
+  } else {
+    putOutput( line, len );
   }
+  putOutput( "\n", 1 );
+}
+
+/** The endList() function writes out any of the list still waiting in the
+    buffer.
+  */
+void endList( void )
+{
+  flushOutput();
 }
\ No newline at end of file
@@ -11,8 +11,6 @@
 #include "list.h"
 #include "pattern.h"
 
-#define INPUT_LIMIT 1023
-
 /* This is the starting point of the program. Here, the main function will
    receive command line args for searching a valid input file line-by-line
    for the matching string structure.
@@ -24,8 +22,8 @@ int main ( int argc, char *argv[] )
 {
   
   // Initialize pattern and flags for printing
-  bool lineNums = NULL;
-  bool opp = NULL;
+  bool lineNums = false;
+  bool opp = false;
 
 
   // Check args in flag section
@@ -47,39 +45,66 @@ int main ( int argc, char *argv[] )
     exit( 1 );  
   }
 
-  // Find valid file and open FileStream for reading only
+  // Find valid file and map it, or read it in if it can't be mapped
   char *fileName = argv[ argc - 1 ];
   char *pat = argv[ argc - 2 ];
-  FILE *fp = fopen( fileName, "r");
-  if ( !fp ) {
+  Input *in = openInput( fileName );
+  if ( !in ) {
     fprintf(stderr, "%s%s\n", "Can't open file: ", fileName);
     exit( 1 );
   }
   
-  // Create line array and read each line in the file for comparison
-  char line[ INPUT_LIMIT ];
-  int lno = 1;
+  // Each line is matched where it lies in the input, without copying it
+  char const *line;
+  long len;
   
-  // Validate pattern and begin matching/adding to matchList
+  // Validate pattern and begin matching/printing lines
   if ( validPattern(pat) ) {
-    while ( readLine(fp, line, INPUT_LIMIT) ) {
-      if ( opp ) {
-        if ( !matchPattern(pat, line) ) {
-          addLine(lno, line);
+    Pattern *compiled = compilePattern(pat);
+
+    // Work back from the end of a mapped file to the last line that will be
+    // printed, so the width of the line numbers is known before any line is
+    // printed. Streamed input isn't held, so its numbers widen as they go.
+    char const *lastLine = NULL;
+    long lastLno = 0;
+    if ( in->mapped ) {
+      long start = in->len;
+      while ( !lastLine && readLineBefore(in, &start, &line, &len) ) {
+        if ( matchPattern(compiled, line, len) != opp ) {
+          lastLine = line;
+        }
+      }
+      lastLno = countLines(in, start) + 1;
+    }
+
+    // Then print lines from the start, stopping after that one
+    if ( lastLine || !in->mapped ) {
+      startList(lineNums, lastLno);
+      long lno = 1;
+      while ( readLine(in, &line, &len) ) {
+        if ( line == lastLine ) {
+          addLine(lno, line, len);
+          break;
         }
-      } else {
-        if ( matchPattern(pat, line) ) {
-          addLine(lno, line);
+        if ( matchPattern(compiled, line, len) != opp ) {
+          addLine(lno, line, len);
         }
+        lno++;
       }
-      lno++;
+      endList();
     }
-      
-    printList(lineNums);
-    fclose(fp);
+
+    if ( in->failed ) {
+      closeInput(in);
+      fprintf(stderr, "%s%s\n", "Can't read file: ", fileName);
+      exit( 1 );
+    }
+
+    freePattern(compiled);
+    closeInput(in);
   
   } else {
-    fclose(fp);
+    closeInput(in);
     fprintf( stderr, "Invalid pattern: %s\n", argv[argc - 2]);
     exit( 1 );
   }
@@ -7,6 +7,9 @@
    line of text to determine if it is a match or not.
  */
 
+// For memmem(), which -std=c99 hides
+#define _GNU_SOURCE
+
 #include "pattern.h"
 
 /**
@@ -53,79 +56,326 @@ bool validPattern( char const pat[] )
   return true;
 }
 
-/** The matchPattern() function compares the line of text to the pattern and returns
-    true or false according to the congruency of the two parameters. 
+/** Number of different bytes a line can hold, and so the length of each
+    row of the transition table */
+#define ALPHABET 256
+
+/** Most states a pattern's DFA can have. Patterns like *a??????????? need
+    one state for every mix of recent characters, so past this they're
+    matched with the Shift-And sets instead. */
+#define MAX_STATES 1024
+
+/** State a line is in once it can no longer match */
+#define DEAD_STATE 0
+
+/** Number of bits in each word of a set of pattern positions */
+#define WORD_BITS ( 8 * sizeof( unsigned long ) )
+
+/** The hasPos() function checks if a position is in a set.
+
+    @param set is the set of positions.
+    @param j is the position.
+    @return true if j is in the set. Otherwise, returns false.
+ */
+static bool hasPos( unsigned long const set[], int j )
+{
+  return set[ j / WORD_BITS ] >> ( j % WORD_BITS ) & 1;
+}
+
+/** The addPos() function adds a position to a set.
+
+    @param set is the set of positions.
+    @param j is the position being added.
+ */
+static void addPos( unsigned long set[], int j )
+{
+  set[ j / WORD_BITS ] |= 1UL << ( j % WORD_BITS );
+}
+
+/** The closeSet() function adds the position after each * in a set, since
+    a * can match nothing. Stars are never next to each other, so one shift
+    finds every skip.
+
+    @param p is the compiled pattern.
+    @param set is the set of positions.
+ */
+static void closeSet( Pattern const *p, unsigned long set[] )
+{
+  unsigned long carry = 0;
+  for ( int i = 0; i < p->words; i++ ) {
+    unsigned long skip = set[ i ] & p->stars[ i ];
+    set[ i ] |= skip << 1 | carry;
+    carry = skip >> ( WORD_BITS - 1 );
+  }
+}
+
+/** The stepSet() function moves a set of positions past one character of
+    the line, a word of positions at a time. Positions the character's mask
+    lets through move on by one, and positions on a * stay where they are.
+
+    @param p is the compiled pattern.
+    @param from is the set of positions before the character.
+    @param ch is the character of the line.
+    @param to is where the positions after the character are stored.
+ */
+static void stepSet( Pattern const *p, unsigned long const from[], unsigned char ch,
+                     unsigned long to[] )
+{
+  unsigned long const *mask = p->masks + ch * p->words;
+  unsigned long carry = 0;
+  for ( int i = 0; i < p->words; i++ ) {
+    unsigned long moved = from[ i ] & mask[ i ];
+    to[ i ] = moved << 1 | carry | ( from[ i ] & p->stars[ i ] );
+    carry = moved >> ( WORD_BITS - 1 );
+  }
+  closeSet( p, to );
+}
+
+/** The emptySet() function checks if a set holds no positions.
+
+    @param set is the set of positions.
+    @param words is the number of words in the set.
+    @return true if the set is empty. Otherwise, returns false.
+ */
+static bool emptySet( unsigned long const set[], int words )
+{
+  for ( int i = 0; i < words; i++ ) {
+    if ( set[ i ] ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** The hashSet() function computes a hash of a set of positions, for
+    finding a state that's already been made.
+
+    @param set is the set of positions.
+    @param words is the number of words in the set.
+    @return the hash.
+ */
+static unsigned long hashSet( unsigned long const set[], int words )
+{
+  unsigned long h = 0;
+  for ( int i = 0; i < words; i++ ) {
+    h = ( h ^ set[ i ] ) * 0x9E3779B97F4A7C15UL;
+  }
+  return h ^ h >> 29;
+}
+
+/** The findLiterals() function finds the runs of plain characters in a
+    pattern. They match separate stretches of a line, in order, so any line
+    that matches holds each run after the one before it. Lines that don't
+    can be turned away with fast substring searches before they go through
+    the DFA.
+
+    @param p is the pattern being compiled.
+ */
+static void findLiterals( Pattern *p )
+{
+  p->plain = ( char * ) malloc( p->len + 1 );
+  p->literals = ( char const ** ) malloc( ( p->len / 2 + 1 ) * sizeof( char const * ) );
+  p->literalLens = ( int * ) malloc( ( p->len / 2 + 1 ) * sizeof( int ) );
+  p->literalCount = 0;
+
+  // With stars at both ends and no ?, the runs can go anywhere in order
+  p->literalsOnly = p->len > 0 && p->pat[ 0 ] == '*' && p->pat[ p->len - 1 ] == '*' &&
+                    !strchr( p->pat, '?' );
 
-    @param pat is the given pattern to match text with.
-    @param line is the string being compared to the pattern.
-    @return true if the string matches. Otherwise, returns false.
+  strcpy( p->plain, p->pat );
+  for ( int j = 0; j < p->len; j++ ) {
+    if ( p->plain[ j ] == '*' || p->plain[ j ] == '?' ) {
+      p->plain[ j ] = '\0';
+    } else if ( j == 0 || p->plain[ j - 1 ] == '\0' ) {
+      p->literals[ p->literalCount++ ] = p->plain + j;
+    }
+  }
+
+  for ( int i = 0; i < p->literalCount; i++ ) {
+    p->literalLens[ i ] = strlen( p->literals[ i ] );
+  }
+}
+
+/** The buildStates() function makes the DFA for a pattern, one state for
+    each set of positions a line can leave it in. States are numbered in the
+    order they're found, and each is given its row of the transition table
+    as soon as it's reached.
+
+    @param p is the pattern being compiled.
+    @return true if the DFA fits in MAX_STATES. Otherwise, returns false.
  */
-bool matchPattern( char const pat[], char const line[] )
+static bool buildStates( Pattern *p )
 {
-  int l = strlen(line);
-  int p = strlen(pat);
-  bool match = NULL;
-  bool cur[ strlen(pat) + 1 ];
-  memset(cur, 0, sizeof(bool)* (p + 1));
-  bool next[ strlen(pat) + 1 ];
-  memset(cur, 0, sizeof(bool)* (p + 1));
-
-  
-  cur[0] = true;
-  if( p > 0 && pat[0] == '*') {
-    cur[1] = true;
-  }
-  
-  // Iterate through the list
-  for ( int i = 0; i < l; i++ ) {
-    char ch = line[i];
-    match = false;
-    // Iterate through the pattern
-    for ( int j = 0; j < p; j++ ) {
-      
-      // Check if current we've transitioned states
-      if ( cur[ j ] ) {
-        switch ( pat[ j ] ) {
-          case '?':
-            next[ j + 1 ] = true;
-            if ( j + 1 < p && pat[ j + 1 ] == '*' ) {
-              next[ j + 2 ] = true;
-            }
-            match = true;
-            break;
-          case '*':
-            next[ j ] = true;
-            next[ j + 1 ] = true;
-            match = true;
-            break;
-          default:
-            if ( pat[ j ] == ch ) {
-              next[ j + 1 ] = true;
-              if ( j + 1 < p && pat[ j + 1 ] == '*' ) {
-                next[ j + 2 ] = true;
-              }
-            }
-            match = true;
-            break;
+  int words = p->words;
+  unsigned long *sets = ( unsigned long * ) malloc( MAX_STATES * words * sizeof( unsigned long ) );
+  int slots = 2 * MAX_STATES;
+  int *table = ( int * ) malloc( slots * sizeof( int ) );
+  for ( int i = 0; i < slots; i++ ) {
+    table[ i ] = -1;
+  }
+
+  // Start with the dead state's empty set and the set every line starts in
+  memset( sets, 0, words * sizeof( unsigned long ) );
+  table[ hashSet( sets, words ) % slots ] = DEAD_STATE;
+  memcpy( sets + words, p->first, words * sizeof( unsigned long ) );
+  table[ hashSet( sets + words, words ) % slots ] = 1;
+  p->start = 1;
+  int count = 2;
+
+  bool fits = true;
+  unsigned long to[ words ];
+  for ( int s = 0; fits && s < count; s++ ) {
+    unsigned long const *from = sets + s * words;
+    p->accept[ s ] = hasPos( from, p->len );
+    for ( int ch = 0; ch < ALPHABET; ch++ ) {
+      stepSet( p, from, ch, to );
+
+      // Look for the set among the states made so far
+      int slot = hashSet( to, words ) % slots;
+      while ( table[ slot ] >= 0 &&
+              memcmp( sets + table[ slot ] * words, to, words * sizeof( unsigned long ) ) != 0 ) {
+        slot = ( slot + 1 ) % slots;
+      }
+
+      if ( table[ slot ] < 0 ) {
+        if ( count == MAX_STATES ) {
+          fits = false;
+          break;
         }
+        memcpy( sets + count * words, to, words * sizeof( unsigned long ) );
+        table[ slot ] = count++;
+      }
+      p->next[ s * ALPHABET + ch ] = table[ slot ];
+    }
+  }
+
+  free( table );
+  free( sets );
+  return fits;
+}
+
+/** The compilePattern() function turns a valid pattern into the DFA used to
+    match lines with it, so the work of following the pattern is done once
+    rather than for every line. It starts with the Shift-And masks, which
+    give each byte the set of pattern positions it can move on from, and
+    builds the DFA's states from them.
+
+    @param pat is the given pattern, which has to stay around as long as the
+           compiled one.
+    @return the compiled pattern.
+ */
+Pattern *compilePattern( char const pat[] )
+{
+  Pattern *p = ( Pattern * ) malloc( sizeof( Pattern ) );
+  p->pat = pat;
+  p->len = strlen( pat );
+
+  // There's one position before each character and one more after the last
+  int words = p->len / WORD_BITS + 1;
+  p->words = words;
+  p->masks = ( unsigned long * ) calloc( ALPHABET * words, sizeof( unsigned long ) );
+  p->stars = ( unsigned long * ) calloc( words, sizeof( unsigned long ) );
+  p->first = ( unsigned long * ) calloc( words, sizeof( unsigned long ) );
+  for ( int j = 0; j < p->len; j++ ) {
+    if ( pat[ j ] == '*' ) {
+      addPos( p->stars, j );
+    } else if ( pat[ j ] == '?' ) {
+      for ( int ch = 0; ch < ALPHABET; ch++ ) {
+        addPos( p->masks + ch * words, j );
       }
+    } else {
+      addPos( p->masks + ( unsigned char ) pat[ j ] * words, j );
     }
-    if (!match) {
+  }
+  addPos( p->first, 0 );
+  closeSet( p, p->first );
+  findLiterals( p );
+
+  p->next = ( unsigned short * ) malloc( MAX_STATES * ALPHABET * sizeof( unsigned short ) );
+  p->accept = ( bool * ) malloc( MAX_STATES * sizeof( bool ) );
+  if ( !buildStates( p ) ) {
+    free( p->next );
+    free( p->accept );
+    p->next = NULL;
+    p->accept = NULL;
+  }
+  return p;
+}
+
+/** The freePattern() function frees a compiled pattern.
+
+    @param p is the pattern being freed.
+ */
+void freePattern( Pattern *p )
+{
+  free( p->next );
+  free( p->accept );
+  free( p->masks );
+  free( p->stars );
+  free( p->first );
+  free( p->plain );
+  free( p->literals );
+  free( p->literalLens );
+  free( p );
+}
+
+/** The matchPattern() function compares the line of text to the pattern and returns
+    true or false according to the congruency of the two parameters. 
+
+    @param p is the compiled pattern to match text with.
+    @param line is the line being compared to the pattern, which needn't
+           be terminated.
+    @param len is the number of characters in the line.
+    @return true if the line matches. Otherwise, returns false.
+ */
+bool matchPattern( Pattern const *p, char const line[], long len )
+{
+  // Lines without the pattern's literals in order can't match
+  char const *rest = line;
+  char const *stop = line + len;
+  for ( int i = 0; i < p->literalCount; i++ ) {
+    rest = memmem( rest, stop - rest, p->literals[ i ], p->literalLens[ i ] );
+    if ( !rest ) {
       return false;
     }
-    // Copy the next arr in cur arr
-    memcpy( cur, next, p + 1);
-    memset(next, 0, sizeof(bool) * (p + 1));
+    rest += p->literalLens[ i ];
   }
-  
-  // Check results and return appropriate bool
-  if ( cur[p] ) {
+  if ( p->literalsOnly ) {
     return true;
   }
-  if (pat[p - 1] == '*' ) {
-    return cur[p - 1];
+
+  unsigned char const *ch = ( unsigned char const * ) line;
+  unsigned char const *end = ch + len;
+  if ( p->next ) {
+    int state = p->start;
+    while ( ch < end && state != DEAD_STATE ) {
+      state = p->next[ state * ALPHABET + *ch++ ];
+    }
+    return p->accept[ state ];
+  }
+
+  // Too many states, so run Shift-And on the positions the line could be at,
+  // in one word when the pattern fits
+  if ( p->words == 1 ) {
+    unsigned long const *masks = p->masks;
+    unsigned long stars = p->stars[ 0 ];
+    unsigned long set = p->first[ 0 ];
+    while ( ch < end && set ) {
+      set = ( set & masks[ *ch++ ] ) << 1 | ( set & stars );
+      set |= ( set & stars ) << 1;
+    }
+    return set >> p->len & 1;
   }
-  return false;
-  
-}
 
+  unsigned long cur[ p->words ];
+  unsigned long next[ p->words ];
+  memcpy( cur, p->first, sizeof( cur ) );
+  while ( ch < end ) {
+    stepSet( p, cur, *ch++, next );
+    if ( emptySet( next, p->words ) ) {
+      return false;
+    }
+    memcpy( cur, next, sizeof( cur ) );
+  }
+  return hasPos( cur, p->len );
+}
@@ -3,6 +3,40 @@
 #include <string.h>
 #include <stdbool.h>
 
+/** A pattern compiled for matching many lines. */
+typedef struct {
+  /** The pattern as given on the command line. */
+  char const *pat;
+  /** Number of characters in the pattern. */
+  int len;
+  /** Number of words in each set of pattern positions. */
+  int words;
+  /** Positions each byte can move on from, one set per byte. */
+  unsigned long *masks;
+  /** Positions holding a *. */
+  unsigned long *stars;
+  /** Positions a line starts in. */
+  unsigned long *first;
+  /** Copy of the pattern with its wildcards turned into nulls. */
+  char *plain;
+  /** Runs of plain characters in the pattern, pointing into plain. */
+  char const **literals;
+  /** Number of characters in each run. */
+  int *literalLens;
+  /** Number of runs of plain characters. */
+  int literalCount;
+  /** True if finding the runs in order is enough for a match. */
+  bool literalsOnly;
+  /** Next state for each state and byte, one row of 256 per state, or NULL
+      if the pattern needs too many states and is matched without them. */
+  unsigned short *next;
+  /** True for each state reached once the whole pattern has matched. */
+  bool *accept;
+  /** State before any of the line has been read. */
+  int start;
+} Pattern;
 
 bool validPattern( char const pat[] );
-bool matchPattern( char const pat[], char const line[] );
\ No newline at end of file
+Pattern *compilePattern( char const pat[] );
+void freePattern( Pattern *p );
+bool matchPattern( Pattern const *p, char const line[], long len );
@@ -119,11 +119,34 @@ if [ -x match ] ; then
     args=(\'abc\' not-a-real-file.txt)
     runTest 20 1
     
-    args=(\'*1*\' file-f.txt)
-    runTest 21 1
+    args=(-v -n \'*8*\' file-f.txt)
+    runTest 21 0
 	  
-    args=(\'xyz\' file-g.txt)
-    runTest 22 1
+    args=(-n \'*1----+----2----\' file-g.txt)
+    runTest 22 0
+
+    args=(\'*e??????????\' file-d.txt)
+    runTest 23 0
+
+    # Piped input isn't held, so line numbers widen as they're printed
+    args=(-n \'?Z\' \<\(cat file-b.txt\))
+    runTest 24 0
+
+    # Piped input is read in blocks, so lines cross from one block into the
+    # next. It should match the same lines as the mapped file.
+    rm -f big.txt
+    for i in $(seq 40); do cat file-d.txt file-f.txt >> big.txt; done
+    head -c 3000000 /dev/zero | tr '\0' x >> big.txt
+    echo "Pipe test: ./match '*a*' <(cat big.txt)"
+    if ! ./match '*a*' big.txt > expected.txt ||
+       ! ./match '*a*' <(cat big.txt) > output.txt ||
+       ! diff -q expected.txt output.txt >/dev/null 2>&1; then
+      echo "**** FAILED - piped input didn't match the same lines as the file"
+      FAIL=1
+    else
+      echo "PASS"
+    fi
+    rm -f big.txt expected.txt
 else
     echo "**** Your program didnt compile successfully, so it couldn't be tested."
     FAIL=1
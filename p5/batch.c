@@ -0,0 +1,193 @@
+/**
+   @file batch.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The batch file compresses or decompresses many files in one run, handing
+   the files out to a pool of worker threads that each reuse one context.
+*/
+
+#include "batch.h"
+#include "block.h"
+#include <pthread.h>
+
+/** Number of files the manifest's list has room for at first */
+#define INITIAL_FILES 16
+
+/** One file of a batch. */
+typedef struct {
+  /** Name of the file being read. */
+  char *inFile;
+  /** Name of the file the output is written to. */
+  char *outFile;
+} BatchFile;
+
+/** Work shared by the worker threads in runBatch(). */
+typedef struct {
+  /** Files being processed. */
+  BatchFile *files;
+  /** Number of files. */
+  int count;
+  /** Function run on each file. */
+  FileFunc func;
+  /** Passed to func. */
+  void *arg;
+  /** Index of the next file no worker has taken yet. */
+  int next;
+  /** Lock protecting next. */
+  pthread_mutex_t lock;
+} BatchPool;
+
+/** What each worker thread is given. */
+typedef struct {
+  /** Pool the worker takes files from. */
+  BatchPool *pool;
+  /** Context the worker uses for all its files. */
+  LZW *z;
+} BatchWorker;
+
+/* Worker thread, taking files one at a time until there are none left.
+
+   @param arg is the worker's BatchWorker.
+   @return NULL.
+*/
+static void *batchWorker( void *arg )
+{
+  BatchWorker *w = ( BatchWorker * ) arg;
+  BatchPool *pool = w->pool;
+
+  while ( true ) {
+    pthread_mutex_lock( &pool->lock );
+    int i = pool->next++;
+    pthread_mutex_unlock( &pool->lock );
+
+    if ( i >= pool->count ) {
+      return NULL;
+    }
+
+    pool->func( w->z, pool->files[ i ].inFile, pool->files[ i ].outFile, pool->arg );
+  }
+}
+
+/* Cuts the next name off a line, ending it with a null.
+
+   @param pos is where to start looking, moved past the name.
+   @return the name, or NULL if the line has no more.
+*/
+static char *nextName( char **pos )
+{
+  char *p = *pos;
+  while ( *p == ' ' || *p == '\t' || *p == '\r' ) {
+    p++;
+  }
+
+  if ( *p == '\0' ) {
+    *pos = p;
+    return NULL;
+  }
+
+  char *name = p;
+  while ( *p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' ) {
+    p++;
+  }
+  if ( *p != '\0' ) {
+    *p++ = '\0';
+  }
+
+  *pos = p;
+  return name;
+}
+
+/* Splits a manifest into its files. The names point into the buffer, so it
+   has to outlive them.
+
+   @param manifest is the buffer holding the manifest.
+   @param count is where the number of files is stored.
+   @return the array of files.
+*/
+static BatchFile *readManifest( Buffer *manifest, int *count )
+{
+  int cap = INITIAL_FILES;
+  BatchFile *files = ( BatchFile * ) malloc( cap * sizeof( BatchFile ) );
+  *count = 0;
+
+  // Put a null after the last line, so every line ends with one
+  appendByte( manifest, '\n' );
+  for ( int i = 0; i < manifest->len; i++ ) {
+    if ( manifest->data[ i ] == '\n' ) {
+      manifest->data[ i ] = '\0';
+    } else if ( manifest->data[ i ] == '\0' ) {
+      BATCH_ERROR( "Invalid manifest" );
+    }
+  }
+
+  char *line = manifest->data;
+  char *end = manifest->data + manifest->len;
+  while ( line < end ) {
+    char *next = line + strlen( line ) + 1;
+    char *inFile = nextName( &line );
+    if ( inFile ) {
+      char *outFile = nextName( &line );
+      if ( !outFile || nextName( &line ) ) {
+        BATCH_ERROR( "Invalid manifest" );
+      }
+
+      if ( *count == cap ) {
+        cap *= 2;
+        files = ( BatchFile * ) realloc( files, cap * sizeof( BatchFile ) );
+      }
+      files[ *count ].inFile = inFile;
+      files[ *count ].outFile = outFile;
+      ( *count )++;
+    }
+    line = next;
+  }
+
+  return files;
+}
+
+char const *findManifest( int argc, char *argv[] )
+{
+  for ( int i = 1; i + 1 < argc; i++ ) {
+    if ( strcmp( "--batch", argv[ i ] ) == 0 ) {
+      return argv[ i + 1 ];
+    }
+  }
+  return NULL;
+}
+
+void runBatch( char const *manifest, int threads, ContextFunc make, FileFunc func, void *arg )
+{
+  Buffer *list = loadBuffer( manifest );
+  int count;
+  BatchFile *files = readManifest( list, &count );
+
+  BatchPool pool = { files, count, func, arg, 0 };
+  pthread_mutex_init( &pool.lock, NULL );
+
+  // No point starting more workers than there are files
+  if ( threads > count ) {
+    threads = count;
+  }
+
+  BatchWorker workers[ MAX_THREADS ];
+  for ( int i = 0; i < threads; i++ ) {
+    workers[ i ].pool = &pool;
+    workers[ i ].z = make( arg );
+  }
+
+  pthread_t ids[ MAX_THREADS ];
+  for ( int i = 0; i < threads; i++ ) {
+    if ( pthread_create( &ids[ i ], NULL, batchWorker, &workers[ i ] ) != 0 ) {
+      BATCH_ERROR( "Can't create worker thread" );
+    }
+  }
+
+  for ( int i = 0; i < threads; i++ ) {
+    pthread_join( ids[ i ], NULL );
+    lzwFree( workers[ i ].z );
+  }
+
+  pthread_mutex_destroy( &pool.lock );
+  free( files );
+  freeBuffer( list );
+}
@@ -0,0 +1,47 @@
+/**
+   @file batch.h
+   @author Stephen Gonsalves (dkgonsal)
+
+   The batch file compresses or decompresses many files in one run, so
+   process start and setting up a context are paid once rather than per
+   file. The files come from a manifest with one pair of input and output
+   names on each line. Each worker thread makes one context before the batch
+   starts and reuses it, dictionary and all, for every file it takes.
+*/
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "lzw.h"
+
+/** Error for a manifest that can't be read */
+#define BATCH_ERROR( msg ) { fprintf( stderr, "%s\n", msg ); exit( 1 ); }
+
+/** Function that makes the context one worker uses for all its files */
+typedef LZW *( *ContextFunc )( void *arg );
+
+/** Function that processes one file of a batch with a worker's context */
+typedef void ( *FileFunc )( LZW *z, char const *inFile, char const *outFile, void *arg );
+
+/* Finds the manifest named after --batch on the command line.
+
+   @param argc is the number of command line arguments.
+   @param argv is the array of command line arguments.
+   @return the name of the manifest, or NULL if there's no --batch.
+*/
+char const *findManifest( int argc, char *argv[] );
+
+/* Processes every file named in a manifest. Each line of the manifest holds
+   an input name and an output name separated by spaces or tabs, and blank
+   lines are skipped. The contexts are all made before any file is started,
+   so a bad option is reported once. Exits if the manifest can't be read.
+
+   @param manifest is the name of the manifest, or - for standard input.
+   @param threads is the number of worker threads to use.
+   @param make is the function that makes each worker's context.
+   @param func is the function run on each file.
+   @param arg is passed to make and func.
+*/
+void runBatch( char const *manifest, int threads, ContextFunc make, FileFunc func, void *arg );
+
+#endif
@@ -0,0 +1,111 @@
+#!/bin/bash
+# This is a shell script to measure deflate and inflate on the test
+# corpora and on generated inputs, so changes that slow them down or make
+# them use more memory show up.  Run it with "make bench".
+#
+# Each run prints one tab-separated line on standard output:
+#
+#   input bytes bits ratio deflate_mbs deflate_rss_kb inflate_mbs inflate_rss_kb result
+#
+# where ratio is the original size over the compressed size, MB/s are
+# megabytes of original input per second, and result is ok if the
+# inflated output matched the original.  Progress goes to standard error.
+#
+# These environment variables change what's measured:
+#
+#   BENCH_SIZES  generated input sizes in megabytes (default "1 16 256 1024")
+#   BENCH_BITS   code widths to try (default "9 12 16 20 24")
+#   BENCH_KINDS  generated inputs (default "random text repetitive")
+
+SIZES=${BENCH_SIZES:-1 16 256 1024}
+BITS=${BENCH_BITS:-9 12 16 20 24}
+KINDS=${BENCH_KINDS:-random text repetitive}
+
+# Generated inputs and outputs go here, and are removed at the end.
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# Make an input of the given kind ($1) and number of megabytes ($2) in $3.
+makeInput() {
+  KIND="$1"
+  BYTES=$(( $2 * 1048576 ))
+  FILE="$3"
+
+  case "$KIND" in
+    random)
+      head -c "$BYTES" /dev/urandom > "$FILE"
+      ;;
+    text)
+      # Random lines of words drawn from the Hamlet test input, so the word
+      # frequencies look like English but the input never repeats.
+      tr -cs 'A-Za-z' '\n' < original-07 | sort -u > "$WORK/words"
+      awk 'BEGIN { srand( 230 ) }
+           { word[ n++ ] = $0 }
+           END {
+             while ( 1 ) {
+               line = word[ int( rand() * n ) ]
+               len = 4 + int( rand() * 10 )
+               for ( i = 1; i < len; i++ )
+                 line = line " " word[ int( rand() * n ) ]
+               print line "."
+             }
+           }' "$WORK/words" 2> /dev/null | head -c "$BYTES" > "$FILE"
+      ;;
+    repetitive)
+      yes "The quick brown fox jumps over the lazy dog." | head -c "$BYTES" > "$FILE"
+      ;;
+  esac
+}
+
+# Compress and decompress one input ($2, named $1) at one code width ($3),
+# printing a line of results.
+benchOne() {
+  NAME="$1"
+  FILE="$2"
+  WIDTH="$3"
+  SIZE=$(stat -c %s "$FILE")
+
+  echo "bench $NAME at $WIDTH bits" >&2
+
+  read DSEC DRSS < <(./benchRun ./deflate -b "$WIDTH" "$FILE" "$WORK/compressed")
+  read ISEC IRSS < <(./benchRun ./inflate -b "$WIDTH" "$WORK/compressed" "$WORK/output")
+  CSIZE=$(stat -c %s "$WORK/compressed")
+
+  RESULT=ok
+  if ! cmp -s "$FILE" "$WORK/output"; then
+    RESULT=mismatch
+  fi
+
+  awk -v name="$NAME" -v size="$SIZE" -v bits="$WIDTH" -v csize="$CSIZE" \
+      -v dsec="$DSEC" -v drss="$DRSS" -v isec="$ISEC" -v irss="$IRSS" -v result="$RESULT" \
+      'function mbs( sec ) { return sec > 0 ? size / 1048576 / sec : 0 }
+       BEGIN {
+         printf "%s\t%d\t%d\t%.3f\t%.2f\t%d\t%.2f\t%d\t%s\n", name, size, bits,
+                ( csize > 0 ? size / csize : 0 ), mbs( dsec ), drss, mbs( isec ), irss, result
+       }'
+
+  rm -f "$WORK/compressed" "$WORK/output"
+}
+
+make -s deflate inflate benchRun || exit 1
+
+printf "input\tbytes\tbits\tratio\tdeflate_mbs\tdeflate_rss_kb\tinflate_mbs\tinflate_rss_kb\tresult\n"
+
+# The test corpora big enough to time
+for FILE in original-*; do
+  if [ $(stat -c %s "$FILE") -ge 1024 ]; then
+    for WIDTH in $BITS; do
+      benchOne "$FILE" "$FILE" "$WIDTH"
+    done
+  fi
+done
+
+for KIND in $KINDS; do
+  for MB in $SIZES; do
+    makeInput "$KIND" "$MB" "$WORK/input"
+    for WIDTH in $BITS; do
+      benchOne "$KIND-${MB}M" "$WORK/input" "$WIDTH"
+    done
+    rm -f "$WORK/input"
+  done
+done
@@ -0,0 +1,62 @@
+/**
+   @file benchRun.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The benchRun file runs a command and reports how long it took and the most
+   memory it held at once, for bench.sh. It prints the elapsed seconds and the
+   peak resident set size in kilobytes on one line, then exits with the
+   command's exit status.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/** Minimum number of command line arguments */
+#define MIN_ARGS 2
+
+/* Runs the command given on the command line and reports its time and peak
+   memory use.
+
+   @param argc is the number of args received in the terminal.
+   @param argv is the command being measured, followed by its arguments.
+*/
+int main( int argc, char *argv[] )
+{
+  if ( argc < MIN_ARGS ) {
+    fprintf( stderr, "usage: benchRun command [args...]\n" );
+    exit( 1 );
+  }
+
+  struct timespec start, end;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+
+  pid_t pid = fork();
+  if ( pid < 0 ) {
+    perror( "fork" );
+    exit( 1 );
+  }
+
+  if ( pid == 0 ) {
+    execvp( argv[ 1 ], argv + 1 );
+    perror( argv[ 1 ] );
+    _exit( 127 );
+  }
+
+  // wait4() gives the child's own resource use, not the total of every child
+  int status;
+  struct rusage usage;
+  if ( wait4( pid, &status, 0, &usage ) < 0 ) {
+    perror( "wait4" );
+    exit( 1 );
+  }
+
+  clock_gettime( CLOCK_MONOTONIC, &end );
+  double seconds = ( end.tv_sec - start.tv_sec ) + ( end.tv_nsec - start.tv_nsec ) / 1e9;
+
+  printf( "%.6f %ld\n", seconds, usage.ru_maxrss );
+  return WIFEXITED( status ) ? WEXITSTATUS( status ) : 1;
+}
@@ -0,0 +1,240 @@
+/**
+   @file block.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The block file splits data into independently compressed blocks, runs a
+   compression or decompression function over the blocks on a pool of worker
+   threads, and reads and writes the block container format.
+*/
+
+#include "block.h"
+#include <pthread.h>
+
+/** Number of bytes in each number stored in a container */
+#define INT_BYTES 4
+
+/** Work shared by the worker threads in runBlocks(). */
+typedef struct {
+  /** Blocks being processed. */
+  Block *blocks;
+  /** Number of blocks. */
+  int count;
+  /** Function run on each block. */
+  BlockFunc func;
+  /** Index of the next block no worker has taken yet. */
+  int next;
+  /** Lock protecting next. */
+  pthread_mutex_t lock;
+} BlockPool;
+
+/* Worker thread, taking blocks one at a time until there are none left.
+
+   @param arg is the BlockPool shared by the workers.
+   @return NULL.
+*/
+static void *blockWorker( void *arg )
+{
+  BlockPool *pool = ( BlockPool * ) arg;
+
+  while ( true ) {
+    pthread_mutex_lock( &pool->lock );
+    int i = pool->next++;
+    pthread_mutex_unlock( &pool->lock );
+
+    if ( i >= pool->count ) {
+      return NULL;
+    }
+
+    Block *b = &pool->blocks[ i ];
+    b->result = pool->func( b->data, b->len, b->bits );
+  }
+}
+
+Block *splitBlocks( Buffer *inBuffer, int size, int bits, int *count )
+{
+  *count = ( ( long ) inBuffer->len + size - 1 ) / size;
+  Block *blocks = ( Block * ) malloc( ( *count + 1 ) * sizeof( Block ) );
+
+  for ( int i = 0; i < *count; i++ ) {
+    blocks[ i ].data = inBuffer->data + ( long ) i * size;
+    blocks[ i ].len = i == *count - 1 ? inBuffer->len - ( long ) i * size : size;
+    blocks[ i ].rawLen = blocks[ i ].len;
+    blocks[ i ].bits = bits;
+    blocks[ i ].result = NULL;
+  }
+
+  return blocks;
+}
+
+/* Reads the entries of a container's index into a new array of blocks,
+   leaving their data pointers NULL. Exits if an entry can't be right.
+
+   @param index is the start of the index.
+   @param count is the number of entries in the index.
+   @param bits is the code width of the container.
+   @return the array of blocks.
+*/
+static Block *readEntries( char const *index, int count, int bits )
+{
+  Block *blocks = ( Block * ) malloc( ( count + 1 ) * sizeof( Block ) );
+
+  for ( int i = 0; i < count; i++ ) {
+    blocks[ i ].data = NULL;
+    blocks[ i ].len = readInt( index + i * BLOCK_ENTRY_LEN, INT_BYTES );
+    blocks[ i ].rawLen = readInt( index + i * BLOCK_ENTRY_LEN + INT_BYTES, INT_BYTES );
+    blocks[ i ].bits = bits;
+    blocks[ i ].result = NULL;
+
+    if ( blocks[ i ].len < 0 || blocks[ i ].rawLen < 0 ) {
+      free( blocks );
+      BLOCK_ERROR( "Invalid block container" );
+    }
+  }
+
+  return blocks;
+}
+
+Block *readContainer( Buffer *inBuffer, int *bits, int *count )
+{
+  if ( inBuffer->len < BLOCK_HEADER_LEN ||
+       memcmp( inBuffer->data, BLOCK_MAGIC, BLOCK_MAGIC_LEN ) != 0 ) {
+    BLOCK_ERROR( "Invalid block container" );
+  }
+
+  *bits = ( unsigned char ) inBuffer->data[ BLOCK_MAGIC_LEN ];
+  *count = readInt( inBuffer->data + BLOCK_MAGIC_LEN + 1, INT_BYTES );
+
+  // The index has to fit in what's left before we trust the count
+  long pos = BLOCK_HEADER_LEN;
+  if ( *count < 0 || ( long ) *count * BLOCK_ENTRY_LEN > inBuffer->len - pos ) {
+    BLOCK_ERROR( "Invalid block container" );
+  }
+
+  Block *blocks = readEntries( inBuffer->data + pos, *count, *bits );
+  long dataPos = pos + ( long ) *count * BLOCK_ENTRY_LEN;
+
+  for ( int i = 0; i < *count; i++ ) {
+    if ( blocks[ i ].len > inBuffer->len - dataPos ) {
+      free( blocks );
+      BLOCK_ERROR( "Invalid block container" );
+    }
+    blocks[ i ].data = inBuffer->data + dataPos;
+    dataPos += blocks[ i ].len;
+  }
+
+  return blocks;
+}
+
+Block *readIndex( FILE *fp, int *bits, int *count )
+{
+  Buffer *index = makeBuffer();
+  reserveBuffer( index, BLOCK_HEADER_LEN );
+
+  if ( fread( index->data, 1, BLOCK_HEADER_LEN, fp ) != BLOCK_HEADER_LEN ||
+       memcmp( index->data, BLOCK_MAGIC, BLOCK_MAGIC_LEN ) != 0 ) {
+    BLOCK_ERROR( "Invalid block container" );
+  }
+
+  *bits = ( unsigned char ) index->data[ BLOCK_MAGIC_LEN ];
+  *count = readInt( index->data + BLOCK_MAGIC_LEN + 1, INT_BYTES );
+
+  // When the file's size is known, the index has to fit in it
+  long fileLen = streamLength( fp );
+  long indexLen = ( long ) *count * BLOCK_ENTRY_LEN;
+  if ( *count < 0 || ( fileLen != -1 && indexLen > fileLen - BLOCK_HEADER_LEN ) ) {
+    BLOCK_ERROR( "Invalid block container" );
+  }
+
+  reserveBuffer( index, indexLen );
+  if ( ( long ) fread( index->data, 1, indexLen, fp ) != indexLen ) {
+    BLOCK_ERROR( "Invalid block container" );
+  }
+
+  Block *blocks = readEntries( index->data, *count, *bits );
+  freeBuffer( index );
+  return blocks;
+}
+
+void runBlocks( Block *blocks, int count, int threads, BlockFunc func )
+{
+  BlockPool pool = { blocks, count, func, 0 };
+  pthread_mutex_init( &pool.lock, NULL );
+
+  // No point starting more workers than there are blocks
+  if ( threads > count ) {
+    threads = count;
+  }
+
+  pthread_t workers[ MAX_THREADS ];
+  for ( int i = 0; i < threads; i++ ) {
+    if ( pthread_create( &workers[ i ], NULL, blockWorker, &pool ) != 0 ) {
+      BLOCK_ERROR( "Can't create worker thread" );
+    }
+  }
+
+  for ( int i = 0; i < threads; i++ )
+    pthread_join( workers[ i ], NULL );
+
+  pthread_mutex_destroy( &pool.lock );
+}
+
+Buffer *packContainer( Block *blocks, int count, int bits )
+{
+  Buffer *outBuffer = makeBuffer();
+
+  long total = BLOCK_HEADER_LEN + ( long ) count * BLOCK_ENTRY_LEN;
+  for ( int i = 0; i < count; i++ )
+    total += blocks[ i ].result->len;
+  reserveBuffer( outBuffer, total );
+
+  for ( int i = 0; i < BLOCK_MAGIC_LEN; i++ ) {
+    appendByte( outBuffer, BLOCK_MAGIC[ i ] );
+  }
+  appendByte( outBuffer, ( char ) bits );
+  appendInt( outBuffer, count, INT_BYTES );
+
+  for ( int i = 0; i < count; i++ ) {
+    appendInt( outBuffer, blocks[ i ].result->len, INT_BYTES );
+    appendInt( outBuffer, blocks[ i ].rawLen, INT_BYTES );
+  }
+
+  for ( int i = 0; i < count; i++ ) {
+    memcpy( outBuffer->data + outBuffer->len, blocks[ i ].result->data, blocks[ i ].result->len );
+    outBuffer->len += blocks[ i ].result->len;
+  }
+
+  return outBuffer;
+}
+
+Buffer *joinBlocks( Block *blocks, int count )
+{
+  // Check every block against the index before trusting its sizes
+  long total = 0;
+  for ( int i = 0; i < count; i++ ) {
+    if ( blocks[ i ].result->len != blocks[ i ].rawLen ) {
+      BLOCK_ERROR( "Invalid block container" );
+    }
+    total += blocks[ i ].rawLen;
+  }
+
+  Buffer *outBuffer = makeBuffer();
+  reserveBuffer( outBuffer, total );
+
+  for ( int i = 0; i < count; i++ ) {
+    memcpy( outBuffer->data + outBuffer->len, blocks[ i ].result->data, blocks[ i ].rawLen );
+    outBuffer->len += blocks[ i ].rawLen;
+  }
+
+  return outBuffer;
+}
+
+void freeBlocks( Block *blocks, int count )
+{
+  for ( int i = 0; i < count; i++ ) {
+    if ( blocks[ i ].result ) {
+      freeBuffer( blocks[ i ].result );
+    }
+  }
+
+  free( blocks );
+}
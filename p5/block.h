@@ -0,0 +1,123 @@
+/**
+   @file block.h
+   @author Stephen Gonsalves (dkgonsal)
+
+   The block file splits data into independently compressed blocks, runs a
+   compression or decompression function over the blocks on a pool of worker
+   threads, and reads and writes the block container format. A container
+   starts with a magic number, the code width and the number of blocks,
+   followed by the compressed and uncompressed size of every block, then the
+   compressed blocks themselves in order. All numbers are stored high-order
+   byte first.
+*/
+
+#ifndef _BLOCK_H_
+#define _BLOCK_H_
+
+#include "buffer.h"
+
+/** Magic number at the start of a block container */
+#define BLOCK_MAGIC "\x89" "LZB"
+/** Number of bytes in the magic number */
+#define BLOCK_MAGIC_LEN 4
+/** Number of bytes in the container header, magic, width and block count */
+#define BLOCK_HEADER_LEN 9
+/** Number of bytes in each block's entry in the index */
+#define BLOCK_ENTRY_LEN 8
+/** Default number of input bytes compressed with a fresh dictionary in each
+    block. Each block is a point inflate can start decoding from. */
+#define BLOCK_SIZE 262144
+/** Largest number of worker threads */
+#define MAX_THREADS 256
+
+/** Error for a block container that can't be read */
+#define BLOCK_ERROR( msg ) { fprintf( stderr, "%s\n", msg ); exit( 1 ); }
+
+/** One piece of the input that's compressed or decompressed on its own. */
+typedef struct {
+  /** Start of the block's input bytes. */
+  char *data;
+  /** Number of input bytes in the block. */
+  int len;
+  /** Number of bytes the block has when uncompressed. */
+  int rawLen;
+  /** Number of bits in each of the block's codes. */
+  int bits;
+  /** Output of the block, filled in by a worker thread. */
+  Buffer *result;
+} Block;
+
+/** Function that turns one block's input into its output */
+typedef Buffer *( *BlockFunc )( char *data, int len, int bits );
+
+/* Splits a buffer into blocks of at most the given size. The blocks point
+   into the buffer, so it has to outlive them.
+
+   @param inBuffer is the buffer being split.
+   @param size is the largest number of bytes in a block.
+   @param bits is the code width the blocks are compressed with.
+   @param count is where the number of blocks is stored.
+   @return the array of blocks.
+*/
+Block *splitBlocks( Buffer *inBuffer, int size, int bits, int *count );
+
+/* Reads the header and index of a block container, checking that they
+   describe the rest of the buffer. Exits if they don't. The blocks point into
+   the buffer, so it has to outlive them.
+
+   @param inBuffer is the buffer holding the container.
+   @param bits is where the code width of the container is stored.
+   @param count is where the number of blocks is stored.
+   @return the array of blocks.
+*/
+Block *readContainer( Buffer *inBuffer, int *bits, int *count );
+
+/* Reads the header and index of a block container from the start of a
+   stream, leaving the stream at the first block's data so only the blocks
+   that are needed have to be read. The blocks' data pointers are left NULL.
+   Exits if the header or index can't be right.
+
+   @param fp is the stream holding the container.
+   @param bits is where the code width of the container is stored.
+   @param count is where the number of blocks is stored.
+   @return the array of blocks.
+*/
+Block *readIndex( FILE *fp, int *bits, int *count );
+
+/* Runs the given function over every block on a pool of worker threads,
+   passing it the block's code width and storing the block's output in its
+   result field.
+
+   @param blocks is the array of blocks to process.
+   @param count is the number of blocks.
+   @param threads is the number of worker threads to use.
+   @param func is the function run on each block.
+*/
+void runBlocks( Block *blocks, int count, int threads, BlockFunc func );
+
+/* Builds a block container from compressed blocks, in block order.
+
+   @param blocks is the array of compressed blocks.
+   @param count is the number of blocks.
+   @param bits is the code width the blocks were compressed with.
+   @return a buffer holding the container.
+*/
+Buffer *packContainer( Block *blocks, int count, int bits );
+
+/* Joins the outputs of decompressed blocks, in block order, checking that
+   each has the size recorded in the index. Exits if one doesn't.
+
+   @param blocks is the array of decompressed blocks.
+   @param count is the number of blocks.
+   @return a buffer holding the joined output.
+*/
+Buffer *joinBlocks( Block *blocks, int count );
+
+/* Frees an array of blocks and any results they hold.
+
+   @param blocks is the array of blocks being freed.
+   @param count is the number of blocks.
+*/
+void freeBlocks( Block *blocks, int count );
+
+#endif
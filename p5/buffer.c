@@ -10,6 +10,7 @@
 */
 
 #include "buffer.h"
+#include <limits.h>
 
 /* Creates the Buffer structure for utilization in the remaining functions.
 
@@ -84,6 +85,300 @@ void setBit( Buffer const *buffer, int idx, bool bitVal )
   }
 }
 
+/* Makes sure there is room for the given number of bytes past the end of
+   the buffer's data, so they can be stored without further capacity checks.
+
+   @param buffer is the buffer being grown.
+   @param extra is the number of bytes that must fit after the current length.
+*/
+void reserveBuffer( Buffer *buffer, long extra )
+{
+  long need = buffer->len + extra;
+  if ( need > buffer->cap ) {
+    if ( need > INT_MAX ) {
+      SIZE_ERROR();
+    }
+
+    // Grow in long, so the last step can't wrap, and stop at what fits
+    long cap = buffer->cap < INIT_CAP ? INIT_CAP : buffer->cap;
+    while ( need > cap ) {
+      cap *= INC_CAP;
+    }
+    buffer->cap = cap > INT_MAX ? INT_MAX : cap;
+    buffer->data = ( char * ) realloc( buffer->data, buffer->cap );
+  }
+}
+
+/* Starts writing codes to the end of the given buffer.
+
+   @param w is the bit writer being initialized.
+   @param buffer is the buffer the codes are appended to.
+*/
+void initWriter( BitWriter *w, Buffer *buffer )
+{
+  w->buffer = buffer;
+  w->acc = 0;
+  w->count = 0;
+  w->fp = NULL;
+}
+
+/* Starts writing codes to the given buffer, writing it out to a stream each
+   time it fills a chunk, so it never holds more than about STREAM_CHUNK bytes.
+
+   @param w is the bit writer being initialized.
+   @param buffer is the buffer the codes are staged in.
+   @param fp is the stream the buffer is written to.
+*/
+void initStreamWriter( BitWriter *w, Buffer *buffer, FILE *fp )
+{
+  initWriter( w, buffer );
+  w->fp = fp;
+}
+
+/* Writes a code with the given number of bits, high-order bit first.
+
+   @param w is the bit writer receiving the code.
+   @param code is the value being written.
+   @param bits is the number of bits in the code, at most 32.
+*/
+void writeCode( BitWriter *w, unsigned int code, int bits )
+{
+  // There are always fewer than WRITE_BITS bits waiting, so this can't overflow
+  w->acc = ( w->acc << bits ) | ( code & ( ( 1ULL << bits ) - 1 ) );
+  w->count += bits;
+
+  if ( w->count >= WRITE_BITS ) {
+    w->count -= WRITE_BITS;
+    unsigned int word = ( unsigned int ) ( w->acc >> w->count );
+
+    reserveBuffer( w->buffer, WRITE_BITS / BBITS );
+    char *dest = w->buffer->data + w->buffer->len;
+    for ( int i = 0; i < WRITE_BITS / BBITS; i++ ) {
+      dest[ i ] = ( char ) ( word >> ( WRITE_BITS - BBITS * ( i + 1 ) ) );
+    }
+    w->buffer->len += WRITE_BITS / BBITS;
+
+    if ( w->fp && w->buffer->len >= STREAM_CHUNK ) {
+      writeChunk( w->buffer, w->fp );
+    }
+  }
+}
+
+/* Moves any bits still in the accumulator to the buffer, padding the last
+   byte with zeros.
+
+   @param w is the bit writer being flushed.
+*/
+void flushWriter( BitWriter *w )
+{
+  while ( w->count >= BBITS ) {
+    w->count -= BBITS;
+    appendByte( w->buffer, ( char ) ( w->acc >> w->count ) );
+  }
+
+  if ( w->count > 0 ) {
+    appendByte( w->buffer, ( char ) ( w->acc << ( BBITS - w->count ) ) );
+    w->count = 0;
+  }
+  w->acc = 0;
+
+  if ( w->fp ) {
+    writeChunk( w->buffer, w->fp );
+  }
+}
+
+/* Starts reading codes from the start of the given buffer.
+
+   @param r is the bit reader being initialized.
+   @param buffer is the buffer the codes are read from.
+*/
+void initReader( BitReader *r, Buffer *buffer )
+{
+  r->buffer = buffer;
+  r->pos = 0;
+  r->acc = 0;
+  r->count = 0;
+  r->fp = NULL;
+}
+
+/* Starts reading codes from a stream, refilling the given buffer a chunk at a
+   time as the codes in it are used up. Any bytes already in the buffer are
+   read first.
+
+   @param r is the bit reader being initialized.
+   @param buffer is the buffer the chunks are read into.
+   @param fp is the stream the codes are read from.
+*/
+void initStreamReader( BitReader *r, Buffer *buffer, FILE *fp )
+{
+  initReader( r, buffer );
+  r->fp = fp;
+}
+
+/* Reads the next code with the given number of bits, high-order bit first.
+
+   @param r is the bit reader supplying the code.
+   @param code is where the value read is stored.
+   @param bits is the number of bits in the code, at most 32.
+   @return true if a whole code was read. Otherwise, returns false.
+*/
+bool readCode( BitReader *r, unsigned int *code, int bits )
+{
+  // Top up the accumulator with as many whole bytes as will fit
+  if ( r->count < bits ) {
+    while ( r->count <= READ_BITS - BBITS ) {
+      // Bits left over in the accumulator carry across to the next chunk
+      if ( r->pos == r->buffer->len ) {
+        if ( !r->fp ) {
+          break;
+        }
+        r->pos = 0;
+        if ( readChunk( r->buffer, r->fp ) == 0 ) {
+          break;
+        }
+      }
+      r->acc = ( r->acc << BBITS ) | ( unsigned char ) r->buffer->data[ r->pos++ ];
+      r->count += BBITS;
+    }
+
+    if ( r->count < bits ) {
+      return false;
+    }
+  }
+
+  r->count -= bits;
+  *code = ( unsigned int ) ( ( r->acc >> r->count ) & ( ( 1ULL << bits ) - 1 ) );
+  return true;
+}
+
+/* Appends a number to the buffer, high-order byte first.
+
+   @param buffer is the buffer the number is appended to.
+   @param val is the number being stored.
+   @param bytes is the number of bytes to store it in.
+*/
+void appendInt( Buffer *buffer, unsigned long long val, int bytes )
+{
+  for ( int i = bytes - 1; i >= 0; i-- ) {
+    appendByte( buffer, ( char ) ( val >> ( i * BBITS ) ) );
+  }
+}
+
+/* Reads a number stored high-order byte first.
+
+   @param data is where the number starts.
+   @param bytes is the number of bytes it's stored in.
+   @return the number.
+*/
+unsigned long long readInt( char const *data, int bytes )
+{
+  unsigned long long val = 0;
+  for ( int i = 0; i < bytes; i++ ) {
+    val = ( val << BBITS ) | ( unsigned char ) data[ i ];
+  }
+  return val;
+}
+
+/* Opens a file for reading or writing, with STD_STREAM standing for
+   standard input or standard output. Exits if the file can't be opened.
+
+   @param filename is the name of the file to open.
+   @param mode is the fopen() mode, starting with 'r' or 'w'.
+   @return the open stream.
+*/
+FILE *openStream( char const *filename, char const *mode )
+{
+  if ( strcmp( filename, STD_STREAM ) == 0 ) {
+    return mode[ 0 ] == 'r' ? stdin : stdout;
+  }
+
+  FILE *fp = fopen( filename, mode );
+
+  // handle invalid file
+  if ( !fp ) {
+    STREAM_ERROR( filename );
+  }
+  return fp;
+}
+
+/* Closes a stream opened with openStream(), only flushing it if it's
+   standard input or standard output.
+
+   @param fp is the stream being closed.
+*/
+void closeStream( FILE *fp )
+{
+  if ( fp == stdin || fp == stdout ) {
+    fflush( fp );
+  } else {
+    fclose( fp );
+  }
+}
+
+/* Finds the size of the file behind a stream.
+
+   @param fp is the stream being checked.
+   @return the number of bytes in the file, or -1 if it isn't a regular file.
+*/
+long streamLength( FILE *fp )
+{
+  struct stat info;
+
+  if ( fstat( fileno( fp ), &info ) == -1 || !S_ISREG( info.st_mode ) ) {
+    return -1;
+  }
+  return info.st_size;
+}
+
+/* Replaces the contents of the buffer with the next chunk of a stream.
+
+   @param buffer is the buffer the chunk is read into.
+   @param fp is the stream being read.
+   @return the number of bytes read, zero at the end of the stream.
+*/
+int readChunk( Buffer *buffer, FILE *fp )
+{
+  buffer->len = 0;
+  reserveBuffer( buffer, STREAM_CHUNK );
+  buffer->len = fread( buffer->data, sizeof( char ), STREAM_CHUNK, fp );
+  return buffer->len;
+}
+
+/* Writes the contents of the buffer to a stream and empties the buffer.
+
+   @param buffer is the buffer being written.
+   @param fp is the stream being written to.
+*/
+void writeChunk( Buffer *buffer, FILE *fp )
+{
+  fwrite( buffer->data, sizeof( char ), buffer->len, fp );
+  buffer->len = 0;
+}
+
+/* Moves a stream forward past the given number of bytes, seeking if it can
+   and reading them otherwise.
+
+   @param fp is the stream being moved forward.
+   @param n is the number of bytes to skip.
+   @return true if the stream had that many bytes. Otherwise, returns false.
+*/
+bool skipStream( FILE *fp, long n )
+{
+  if ( n == 0 || fseek( fp, n, SEEK_CUR ) == 0 ) {
+    return true;
+  }
+
+  char scratch[ BUFSIZ ];
+  while ( n > 0 ) {
+    size_t got = fread( scratch, 1, n < BUFSIZ ? n : BUFSIZ, fp );
+    if ( got == 0 ) {
+      return false;
+    }
+    n -= got;
+  }
+  return true;
+}
+
 /* Reads from a file into the buffer's data field.
    
    @param filename of the file being passed load into the buffer.
@@ -92,18 +387,22 @@ void setBit( Buffer const *buffer, int idx, bool bitVal )
 Buffer *loadBuffer( char const *filename )
 {
   // open the filestream
-  FILE *fp = fopen( filename, "rb" );
-
-  // handle invalid file
-  if ( !fp ) {
-    STREAM_ERROR( filename );
-  }
+  FILE *fp = openStream( filename, "rb" );
 
   // initialize buffer
   Buffer *buffer = makeBuffer();
-    
+
+  // Pipes can't seek, so read them a chunk at a time until they run out
   if ( fseek( fp, 0, SEEK_END ) == -1 ) {
-    STREAM_ERROR( filename );
+    int n;
+    do {
+      reserveBuffer( buffer, STREAM_CHUNK );
+      n = fread( buffer->data + buffer->len, sizeof( char ), STREAM_CHUNK, fp );
+      buffer->len += n;
+    } while ( n > 0 );
+
+    closeStream( fp );
+    return buffer;
   }
   
   double fileLen = ftell( fp );
@@ -120,7 +419,7 @@ Buffer *loadBuffer( char const *filename )
   fread( buffer->data, sizeof( unsigned char ), fileLen, fp );
     
   // close the filestream and return
-  fclose( fp );
+  closeStream( fp );
   return buffer;
 }
 
@@ -132,16 +431,11 @@ Buffer *loadBuffer( char const *filename )
 void saveBuffer( Buffer *buffer, char const *filename )
 {
   // open the filestream
-  FILE *fp = fopen( filename, "wb");
-
-  // handle an invalid file
-  if ( !fp ) {
-    STREAM_ERROR( filename );
-  }
+  FILE *fp = openStream( filename, "wb" );
 
   // write contents of buffer into file
   fwrite( buffer->data, sizeof( char ), buffer->len, fp );
 
   // close the filestream.
-  fclose( fp );
+  closeStream( fp );
 }
\ No newline at end of file
@@ -15,6 +15,8 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 
 /** Number of bits in a byte. */
 #define BBITS 8
@@ -26,16 +28,26 @@
 
 /** Macro for file read error */
 #define STREAM_ERROR( filename ) { perror( filename ); exit( 1 ); }
+/** Error for a buffer that would grow past what its length can count */
+#define SIZE_ERROR() { fprintf( stderr, "Buffer too large\n" ); exit( 1 ); }
 /** Check for capacity of buffer */
 #define CHECK_CAP( char, buffer, INC_CAP ) { if ( buffer->len >= buffer->cap ) { buffer->cap *= INC_CAP; buffer->data = ( char* ) realloc( buffer->data, buffer->cap ); } }
 /** Find the byte index */
 #define FIND_BYTE( idx, BBITS ) idx / BBITS;
 /** Find the bit index in the byte */
 #define FIND_BIT( idx, BBITS ) BBITS - 1 - idx % BBITS;
-/** Usage error sequence */
-#define USAGE_ERROR( x ) { fprintf( stderr, "usage: %s [-d] [-b bits] infile outfile\n", x ); exit( 1 ); }
+/** Number of bits the bit writer moves to its buffer at a time */
+#define WRITE_BITS 32
+/** Number of bits the bit reader's accumulator may be filled to */
+#define READ_BITS 56
+/** Number of bytes read or written at a time when streaming */
+#define STREAM_CHUNK 65536
+/** Filename that stands for standard input or standard output */
+#define STD_STREAM "-"
+/** Usage error sequence, given the program's own usage message */
+#define USAGE_ERROR( usage ) { fputs( usage, stderr ); exit( 1 ); }
 /** Inflate error for invalid compressed file */
-#define INFLATE_ERROR( nextWord, d ) { if ( nextWord > d->dictLength ) { fprintf( stderr, "Undefined code: %d\n", nextWord ); exit( 1 ); } }
+#define INFLATE_ERROR( code ) { fprintf( stderr, "Undefined code: %d\n", code ); exit( 1 ); }
 
 /** Representation of a resizable array of bytes, with functions to
     make it easy to access individual bits. */
@@ -48,6 +60,34 @@ typedef struct {
   int cap;
 } Buffer;
 
+/** Writes whole codes to the end of a Buffer, most significant bit first,
+    through a 64-bit accumulator. */
+typedef struct {
+  /** Buffer the finished bytes are appended to. */
+  Buffer *buffer;
+  /** Bits that haven't been written to the buffer yet, right-aligned. */
+  unsigned long long acc;
+  /** Number of bits waiting in acc. */
+  int count;
+  /** Stream full chunks of the buffer are written to, or NULL to keep them. */
+  FILE *fp;
+} BitWriter;
+
+/** Reads whole codes from a Buffer, most significant bit first, through a
+    64-bit accumulator. */
+typedef struct {
+  /** Buffer the codes are read from. */
+  Buffer *buffer;
+  /** Index of the next byte to move into the accumulator. */
+  int pos;
+  /** Bits that have been read from the buffer but not returned, right-aligned. */
+  unsigned long long acc;
+  /** Number of bits waiting in acc. */
+  int count;
+  /** Stream the buffer is refilled from when it runs out, or NULL. */
+  FILE *fp;
+} BitReader;
+
 /* Creates the Buffer structure for utilization in the remaining functions.
 
    @return the newly created buffer structure.
@@ -85,9 +125,139 @@ bool getBit( Buffer const *buffer, int idx );
 */
 void setBit( Buffer const *buffer, int idx, bool bitVal );
 
+/* Makes sure there is room for the given number of bytes past the end of
+   the buffer's data, so they can be stored without further capacity checks.
+   Exits if the buffer would have to hold more than INT_MAX bytes.
+
+   @param buffer is the buffer being grown.
+   @param extra is the number of bytes that must fit after the current length.
+*/
+void reserveBuffer( Buffer *buffer, long extra );
+
+/* Starts writing codes to the end of the given buffer.
+
+   @param w is the bit writer being initialized.
+   @param buffer is the buffer the codes are appended to.
+*/
+void initWriter( BitWriter *w, Buffer *buffer );
+
+/* Writes a code with the given number of bits, high-order bit first.
+
+   @param w is the bit writer receiving the code.
+   @param code is the value being written.
+   @param bits is the number of bits in the code, at most 32.
+*/
+void writeCode( BitWriter *w, unsigned int code, int bits );
+
+/* Moves any bits still in the accumulator to the buffer, padding the last
+   byte with zeros.
+
+   @param w is the bit writer being flushed.
+*/
+void flushWriter( BitWriter *w );
+
+/* Starts writing codes to the given buffer, writing it out to a stream each
+   time it fills a chunk, so it never holds more than about STREAM_CHUNK bytes.
+
+   @param w is the bit writer being initialized.
+   @param buffer is the buffer the codes are staged in.
+   @param fp is the stream the buffer is written to.
+*/
+void initStreamWriter( BitWriter *w, Buffer *buffer, FILE *fp );
+
+/* Starts reading codes from the start of the given buffer.
+
+   @param r is the bit reader being initialized.
+   @param buffer is the buffer the codes are read from.
+*/
+void initReader( BitReader *r, Buffer *buffer );
+
+/* Starts reading codes from a stream, refilling the given buffer a chunk at a
+   time as the codes in it are used up. Any bytes already in the buffer are
+   read first.
+
+   @param r is the bit reader being initialized.
+   @param buffer is the buffer the chunks are read into.
+   @param fp is the stream the codes are read from.
+*/
+void initStreamReader( BitReader *r, Buffer *buffer, FILE *fp );
+
+/* Reads the next code with the given number of bits, high-order bit first.
+
+   @param r is the bit reader supplying the code.
+   @param code is where the value read is stored.
+   @param bits is the number of bits in the code, at most 32.
+   @return true if a whole code was read. Otherwise, returns false.
+*/
+bool readCode( BitReader *r, unsigned int *code, int bits );
+
+/* Appends a number to the buffer, high-order byte first.
+
+   @param buffer is the buffer the number is appended to.
+   @param val is the number being stored.
+   @param bytes is the number of bytes to store it in.
+*/
+void appendInt( Buffer *buffer, unsigned long long val, int bytes );
+
+/* Reads a number stored high-order byte first.
+
+   @param data is where the number starts.
+   @param bytes is the number of bytes it's stored in.
+   @return the number.
+*/
+unsigned long long readInt( char const *data, int bytes );
+
+/* Opens a file for reading or writing, with STD_STREAM standing for
+   standard input or standard output. Exits if the file can't be opened.
+
+   @param filename is the name of the file to open.
+   @param mode is the fopen() mode, starting with 'r' or 'w'.
+   @return the open stream.
+*/
+FILE *openStream( char const *filename, char const *mode );
+
+/* Closes a stream opened with openStream(), only flushing it if it's
+   standard input or standard output.
+
+   @param fp is the stream being closed.
+*/
+void closeStream( FILE *fp );
+
+/* Finds the size of the file behind a stream.
+
+   @param fp is the stream being checked.
+   @return the number of bytes in the file, or -1 if it isn't a regular file.
+*/
+long streamLength( FILE *fp );
+
+/* Replaces the contents of the buffer with the next chunk of a stream.
+
+   @param buffer is the buffer the chunk is read into.
+   @param fp is the stream being read.
+   @return the number of bytes read, zero at the end of the stream.
+*/
+int readChunk( Buffer *buffer, FILE *fp );
+
+/* Writes the contents of the buffer to a stream and empties the buffer.
+
+   @param buffer is the buffer being written.
+   @param fp is the stream being written to.
+*/
+void writeChunk( Buffer *buffer, FILE *fp );
+
+/* Moves a stream forward past the given number of bytes, seeking if it can
+   and reading them otherwise.
+
+   @param fp is the stream being moved forward.
+   @param n is the number of bytes to skip.
+   @return true if the stream had that many bytes. Otherwise, returns false.
+*/
+bool skipStream( FILE *fp, long n );
+
 /* Reads from a file into the buffer's data field.
    
-   @param filename of the file being passed load into the buffer.
+   @param filename of the file being passed load into the buffer, or STD_STREAM
+          for standard input.
    @return the buffer that is created from the input file.
 */
 Buffer *loadBuffer( char const *filename );
@@ -95,7 +265,8 @@ Buffer *loadBuffer( char const *filename );
 /* Saves the buffer to an output file for loading later when needed.
    
    @param buffer is the buffer who's data is being saved to a file.
-   @param filename is the file the buffer's data is being saved to.
+   @param filename is the file the buffer's data is being saved to, or STD_STREAM
+          for standard output.
 */
 void saveBuffer( Buffer *buffer, char const *filename );
 
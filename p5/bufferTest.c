@@ -4,6 +4,8 @@
 #include <string.h>
 
 #include "buffer.h"
+#include "pack.h"
+#include "unpack.h"
 
 int main()
 {
@@ -172,6 +174,114 @@ int main()
   }
 
   freeBuffer( buffer );
+
+  /////////////////////////////////////////////////////
+
+  // Try writing whole codes with the bit writer, at a few different widths.
+  // The bits should come out in the same order setBit() would put them.
+  buffer = makeBuffer();
+  BitWriter writer;
+  initWriter( &writer, buffer );
+
+  writeCode( &writer, 0x1A5, 9 );        // 110100101
+  writeCode( &writer, 0x3, 2 );          // 11
+  writeCode( &writer, 0xABCDE, 20 );     // 10101011110011011110
+  writeCode( &writer, 0xFFFFFFFF, 32 );  // 32 ones
+  writeCode( &writer, 0x0, 8 );          // 00000000
+  flushWriter( &writer );
+
+  // 71 bits, so 9 bytes with a zero bit of padding at the end.
+  char codeBits[] = "110100101" "11" "10101011110011011110"
+    "11111111111111111111111111111111" "00000000" "0";
+  n = strlen( codeBits );
+  assert( buffer->len == n / 8 );
+  for ( int i = 0; i < n; i++ ) {
+    if ( codeBits[ i ] == '0' )
+      assert( getBit( buffer, i ) == 0 );
+    else
+      assert( getBit( buffer, i ) != 0 );
+  }
+
+  // Read the same codes back with the bit reader.
+  BitReader reader;
+  unsigned int code;
+  initReader( &reader, buffer );
+
+  assert( readCode( &reader, &code, 9 ) && code == 0x1A5 );
+  assert( readCode( &reader, &code, 2 ) && code == 0x3 );
+  assert( readCode( &reader, &code, 20 ) && code == 0xABCDE );
+  assert( readCode( &reader, &code, 32 ) && code == 0xFFFFFFFF );
+  assert( readCode( &reader, &code, 8 ) && code == 0x0 );
+
+  // Only the padding bit is left, which isn't enough for another code.
+  assert( !readCode( &reader, &code, 8 ) );
+
+  freeBuffer( buffer );
+
+  /////////////////////////////////////////////////////
+
+  // Unpacking codes in batches gives the same codes as reading them one at
+  // a time, at every width and starting on every bit of a byte.
+  buffer = makeBuffer();
+  srand( 230 );
+  for ( int i = 0; i < 4096; i++ )
+    appendByte( buffer, rand() );
+
+  unsigned int one[ 4200 ], many[ 4200 ];
+  for ( int width = 8; width <= 32; width++ ) {
+    for ( int skip = 0; skip < 8; skip++ ) {
+      initReader( &reader, buffer );
+      if ( skip )
+        readCode( &reader, &code, skip );
+      int count = 0;
+      while ( count < 4200 && readCode( &reader, &one[ count ], width ) )
+        count++;
+
+      initReader( &reader, buffer );
+      if ( skip )
+        readCode( &reader, &code, skip );
+      int first = count < 1000 ? count : 1000;
+      assert( readCodes( &reader, many, 1000, width ) == first );
+      assert( readCodes( &reader, many + first, 4200, width ) == count - first );
+      assert( memcmp( one, many, count * sizeof( unsigned int ) ) == 0 );
+      assert( !readCode( &reader, &code, width ) );
+
+      int scalar = unpackScalar( ( unsigned char * ) buffer->data, buffer->len, skip,
+                                 width, many, count );
+      assert( scalar > 0 && scalar <= count );
+      assert( memcmp( one, many, scalar * sizeof( unsigned int ) ) == 0 );
+    }
+  }
+
+  freeBuffer( buffer );
+
+  /////////////////////////////////////////////////////
+
+  // Packing codes in batches gives the same bits as writing them one at a
+  // time, at every width and after codes of another width.
+  for ( int width = 2; width <= 32; width++ ) {
+    Buffer *single = makeBuffer();
+    Buffer *batched = makeBuffer();
+    BitWriter batchWriter;
+    initWriter( &writer, single );
+    initWriter( &batchWriter, batched );
+    writeCode( &writer, 0x5, 3 );
+    writeCode( &batchWriter, 0x5, 3 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+      one[ i ] = rand();
+      writeCode( &writer, one[ i ], width );
+    }
+    writeCodes( &batchWriter, one, 600, width );
+    writeCodes( &batchWriter, one + 600, 400, width );
+    flushWriter( &writer );
+    flushWriter( &batchWriter );
+
+    assert( single->len == batched->len );
+    assert( memcmp( single->data, batched->data, single->len ) == 0 );
+    freeBuffer( single );
+    freeBuffer( batched );
+  }
   
   return EXIT_SUCCESS;
 }
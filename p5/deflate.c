@@ -6,8 +6,12 @@
    that are written into a file using the fwrite() function.
 */
 
-#include "dictionary.h"
-#include "buffer.h"
+#include "lzw.h"
+#include "block.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "stats.h"
+#include <unistd.h>
 
 /** Minimum number of bits in an entry */
 #define MIN_BITS 8
@@ -16,57 +20,293 @@
 /** Minimum number of command line arguments */
 #define MIN_ARGS 3
 /** Maximum number of command line arguments */
-#define MAX_ARGS 6
+#define MAX_ARGS 15
 /** Indexes for file arguments */
 #define FILE_ARGS 2
+/** Usage message for the options deflate takes */
+#define USAGE \
+  "usage: deflate [-d] [-v] [-H] [-s] [-b bits|auto] [-j threads]\n" \
+  "               [--stream] [--pipeline] [--huffman]\n" \
+  "               [--checkpoint bytes] [-D dictfile] [--train]\n" \
+  "               [--max-dict-mem bytes]\n" \
+  "               (infile outfile | --batch manifest)\n" \
+  "-s times reading, coding and writing; coding includes bit packing\n"
+/** Number of input bytes -b auto tries each code width on */
+#define AUTO_SAMPLE 1048576
 
-/* The LZW compression algorithm implemented as a helper function.
+/* Compresses one block of a container with a fresh dictionary. Run on a
+   worker thread by runBlocks().
 
-   @param d the dictionary being used for word writing/searching.
-   @param inBuffer the buffer being used for compression.
+   @param data the block's input bytes.
+   @param len number of bytes in the block.
    @param bits number of bits indicated by argument.
-   @return the buffer to the main function.
+   @return the compressed block.
 */
-Buffer *deflate( Dictionary *d, Buffer *inBuffer, int bits )
-{  
-  Buffer *outBuffer = makeBuffer();
-  int max = 1, loc = 0, inc = 0, len = 0;
+static Buffer *deflateBlock( char *data, int len, int bits )
+{
+  LZW *z = lzwMake( bits, false, false );
 
-  for ( int i = 0; i < inBuffer->len; i += inc ) {
-    int maxLength = max;
+  Buffer *outBuffer = lzwDeflate( z, data, len );
+  lzwFree( z );
+  return outBuffer;
+}
 
-    if ( inBuffer->len <  i + maxLength ) {
-      maxLength = inBuffer->len - i;
-    }
-    int dictIndex = lookupWord( d, inBuffer->data + i, maxLength );
+/* Compresses one trial of -b auto with variable width codes. Run on a worker
+   thread by runBlocks().
 
-    while ( dictIndex == -1 ) {
-      dictIndex = lookupWord( d, inBuffer->data + i, --maxLength );
-    }
-    while ( outBuffer->len * BBITS - loc < bits ) {
-      appendByte( outBuffer, ( int ) 0); //0x00 not working
-    }
+   @param data the input bytes.
+   @param len number of input bytes.
+   @param bits largest number of bits in a code.
+   @return the compressed codes.
+*/
+static Buffer *deflateVarBlock( char *data, int len, int bits )
+{
+  LZW *z = lzwMake( bits, true, false );
 
-    for ( int j = 0; j < bits; j++ ) {
-      setBit( outBuffer, loc++, dictIndex & ( 0x01 << ( bits - 1 - j )));
-    }
+  Buffer *outBuffer = lzwDeflate( z, data, len );
+  lzwFree( z );
+  return outBuffer;
+}
 
-    len = d->wordLen[ dictIndex ];
-    int newLen = len + 1;
-    inc = newLen - 1;
-    max = ( newLen > max ) ? newLen : max;
-    char *newWord = ( char * ) malloc( sizeof( char ) * newLen );
-        
-    if ( i < inBuffer->len - 1 ) {
-      memcpy( newWord, d->wordList[ dictIndex ], len );
-      newWord[ len ] = inBuffer->data[ i + len ];
-      addWord( d, newWord, maxLength + 1);
+/* Compresses the first len bytes of the input at count widths in a row,
+   one width per block on the worker threads.
+
+   @param inBuffer the input being compressed.
+   @param len number of input bytes each trial compresses.
+   @param bits narrowest width tried.
+   @param count number of widths tried.
+   @param variable true if code widths grow with the dictionary.
+   @param threads number of worker threads.
+   @return the trials, each holding its compressed codes.
+*/
+static Block *runTrials( Buffer *inBuffer, int len, int bits, int count, bool variable,
+                         int threads )
+{
+  Block *trials = ( Block * ) malloc( count * sizeof( Block ) );
+  for ( int i = 0; i < count; i++ ) {
+    trials[ i ].data = inBuffer->data;
+    trials[ i ].len = len;
+    trials[ i ].rawLen = len;
+    trials[ i ].bits = bits + i;
+    trials[ i ].result = NULL;
+  }
+
+  runBlocks( trials, count, threads, variable ? deflateVarBlock : deflateBlock );
+  return trials;
+}
+
+/* Finds the trial with the smallest output. Ties go to the narrower width,
+   which needs less memory to inflate.
+
+   @param trials the trials, in order of width.
+   @param count number of trials.
+   @return the index of the best trial.
+*/
+static int bestTrial( Block *trials, int count )
+{
+  int best = 0;
+  for ( int i = 1; i < count; i++ ) {
+    if ( trials[ i ].result->len < trials[ best ].result->len ) {
+      best = i;
     }
+  }
+  return best;
+}
+
+/* Picks the code width for -b auto and compresses the input at it. The
+   start of the input is compressed at every width that could make a
+   difference. Widths past the one that fits a code for every input byte can
+   only cost more bits, so they aren't tried. When the input is longer than
+   that sample, the sample's pick is only a starting point, since wider
+   dictionaries pay off over more input. The pick is scaled up for the whole
+   input, and the whole input is compressed at that width and the ones on
+   either side of it at once, one per worker thread, so choosing costs about
+   as long as compressing at one width. Fewer threads try fewer widths.
 
-    free( newWord );
+   @param inBuffer the input being compressed.
+   @param variable true if code widths grow with the dictionary.
+   @param threads number of worker threads.
+   @param whole where the compressed codes for the chosen width are stored.
+   @return the chosen number of bits.
+*/
+static int chooseWidth( Buffer *inBuffer, bool variable, int threads, Buffer **whole )
+{
+  int len = inBuffer->len < AUTO_SAMPLE ? inBuffer->len : AUTO_SAMPLE;
+  int minBits = variable ? VAR_MIN_BITS : MIN_BITS;
+  int maxBits = codeWidth( ( long ) inBuffer->len + MIN_DICT_SIZE + 1 );
+  if ( maxBits > MAX_BITS ) {
+    maxBits = MAX_BITS;
+  }
+  int sampleMax = codeWidth( ( long ) len + MIN_DICT_SIZE + 1 );
+  if ( sampleMax > maxBits ) {
+    sampleMax = maxBits;
   }
 
-  return outBuffer;
+  int count = sampleMax - minBits + 1;
+  Block *trials = runTrials( inBuffer, len, minBits, count, variable, threads );
+  int best = bestTrial( trials, count );
+  int bits = trials[ best ].bits;
+  *whole = trials[ best ].result;
+  trials[ best ].result = NULL;
+  freeBlocks( trials, count );
+  if ( len == inBuffer->len ) {
+    return bits;
+  }
+  freeBuffer( *whole );
+
+  // Past the sample, the best width grows by about a bit for every four
+  // times as much input
+  for ( long span = len; span * 2 <= inBuffer->len && bits < maxBits; span *= 4 ) {
+    bits++;
+  }
+
+  // Try the width on its own, then the next one up, then the next one down,
+  // as far as there are threads to run them side by side
+  int lo = bits, hi = bits;
+  if ( threads > 1 && hi < maxBits ) {
+    hi++;
+  }
+  if ( threads > hi - lo + 1 && lo > minBits ) {
+    lo--;
+  }
+
+  count = hi - lo + 1;
+  trials = runTrials( inBuffer, inBuffer->len, lo, count, variable, threads );
+  best = bestTrial( trials, count );
+  bits = trials[ best ].bits;
+  *whole = trials[ best ].result;
+  trials[ best ].result = NULL;
+  freeBlocks( trials, count );
+  return bits;
+}
+
+/* Compresses a file at the code width chooseWidth() picks, with a header
+   recording the width so inflate doesn't have to be told it.
+
+   @param inFile name of the file being compressed.
+   @param outFile name of the file the output is written to.
+   @param variable true if code widths grow with the dictionary.
+*/
+static void deflateAuto( char const *inFile, char const *outFile, bool variable )
+{
+  Buffer *inBuffer = loadBuffer( inFile );
+
+  long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+  int threads = cpus < 1 ? 1 : cpus > MAX_THREADS ? MAX_THREADS : cpus;
+
+  Buffer *codes;
+  int bits = chooseWidth( inBuffer, variable, threads, &codes );
+
+  Buffer *outBuffer = makeBuffer();
+  Header h = { variable ? FLAG_VARIABLE : 0, bits, inBuffer->len };
+  reserveBuffer( outBuffer, HEADER_LEN + codes->len );
+  writeHeader( outBuffer, &h );
+  memcpy( outBuffer->data + outBuffer->len, codes->data, codes->len );
+  outBuffer->len += codes->len;
+  freeBuffer( codes );
+
+  freeBuffer( inBuffer );
+  saveBuffer( outBuffer, outFile );
+  freeBuffer( outBuffer );
+}
+
+/* Trains a dictionary by compressing a sample of typical input, then saves
+   it so deflate and inflate -D can start each input from it.
+
+   @param z the context whose dictionary is trained.
+   @param inFile name of the sample.
+   @param dictFile name of the file the dictionary is saved to.
+*/
+void trainDictionary( LZW *z, char const *inFile, char const *dictFile )
+{
+  Buffer *inBuffer = loadBuffer( inFile );
+  freeBuffer( lzwDeflate( z, inBuffer->data, inBuffer->len ) );
+  freeBuffer( inBuffer );
+
+  if ( !saveDictionary( z->d, dictFile ) ) {
+    STREAM_ERROR( dictFile );
+  }
+}
+
+/* Compresses a file into a block container, compressing the blocks in
+   parallel on the given number of threads. Each block is a checkpoint
+   inflate --range can start decoding from.
+
+   @param inFile name of the file being compressed.
+   @param outFile name of the file the container is written to.
+   @param bits number of bits indicated by argument.
+   @param threads number of worker threads.
+   @param size number of input bytes in each block.
+*/
+void deflateBlocks( char const *inFile, char const *outFile, int bits, int threads, int size )
+{
+  Buffer *inBuffer = loadBuffer( inFile );
+  int count;
+  Block *blocks = splitBlocks( inBuffer, size, bits, &count );
+
+  runBlocks( blocks, count, threads, deflateBlock );
+
+  Buffer *outBuffer = packContainer( blocks, count, bits );
+  freeBlocks( blocks, count );
+  freeBuffer( inBuffer );
+
+  saveBuffer( outBuffer, outFile );
+  freeBuffer( outBuffer );
+}
+
+/** How each file of a --batch run is compressed. */
+typedef struct {
+  /** Number of bits in each code, or the largest width when widths vary. */
+  int bits;
+  /** True if code widths grow with the dictionary. */
+  bool variable;
+  /** True if each output starts with a header. */
+  bool header;
+  /** Name of the trained dictionary every file starts from, or NULL. */
+  char const *dictFile;
+  /** Most bytes each dictionary may use, or 0 for no limit. */
+  long memArg;
+  /** True if the codes are written in a static Huffman code. */
+  bool huffman;
+} BatchOptions;
+
+/* Makes the context one batch worker compresses all its files with.
+
+   @param arg is the BatchOptions for the run.
+   @return the new context.
+*/
+static LZW *makeBatchContext( void *arg )
+{
+  BatchOptions *o = ( BatchOptions * ) arg;
+
+  LZW *z = lzwMake( o->bits, o->variable, o->header );
+  z->huffman = o->huffman;
+  if ( o->dictFile && !lzwUseDictionary( z, o->dictFile ) ) {
+    DICTIONARY_ERROR( o->dictFile );
+  }
+  if ( o->memArg && !lzwLimitMemory( z, o->memArg ) ) {
+    USAGE_ERROR( USAGE );
+  }
+  return z;
+}
+
+/* Compresses one file of a batch, reusing the worker's context.
+
+   @param z the worker's context.
+   @param inFile name of the file being compressed.
+   @param outFile name of the file the output is written to.
+   @param arg is the BatchOptions for the run, already applied to the
+          context by makeBatchContext().
+*/
+static void deflateBatchFile( LZW *z, char const *inFile, char const *outFile, void *arg )
+{
+  ( void ) arg;
+  Buffer *inBuffer = loadBuffer( inFile );
+  Buffer *outBuffer = lzwDeflate( z, inBuffer->data, inBuffer->len );
+  freeBuffer( inBuffer );
+
+  saveBuffer( outBuffer, outFile );
+  freeBuffer( outBuffer );
 }
 
 /* This is the starting point of the deflate program. Using the linked buffer/dictionary
@@ -80,47 +320,222 @@ Buffer *deflate( Dictionary *d, Buffer *inBuffer, int bits )
 int main( int argc, char *argv[] )
 {
   bool printDict = false;
+  bool stream = false;
+  bool variable = false;
+  bool header = false;
+  bool autoBits = false;
+  bool bitsGiven = false;
+  bool train = false;
+  bool pipeline = false;
+  bool huffman = false;
+  bool stats = false;
+  long memArg = 0;
+  char const *dictFile = NULL;
   int bitArg = DEFAULT_BITS;
-  Dictionary *d;
+  int threads = 0;
+  int checkpoint = 0;
 
   if ( argc < MIN_ARGS || argc > MAX_ARGS ) {
-    USAGE_ERROR( "deflate" );
+    USAGE_ERROR( USAGE );
   }
 
-  int inFile = argc - FILE_ARGS;
+  // A batch takes its files from the manifest instead
+  char const *manifest = findManifest( argc, argv );
+  int inFile = manifest ? argc : argc - FILE_ARGS;
   int outFile = argc - 1;
   
   for ( int i = 1; i < inFile; i++ ) {
    if ( strcmp( "-b", argv[ i ] ) == 0 ) {
-      if ( sscanf( argv[ i + 1 ], "%d", &bitArg ) == 1 && 
+      if ( i + 1 < inFile && strcmp( "auto", argv[ i + 1 ] ) == 0 ) {
+        autoBits = true;
+        i++;
+        continue;
+      } else if ( sscanf( argv[ i + 1 ], "%d", &bitArg ) == 1 && 
            bitArg > MIN_BITS - 1 && bitArg < MAX_BITS + 1 ) {
+        bitsGiven = true;
         i++;
         continue;
       } else {
-        USAGE_ERROR( "deflate" );
+        USAGE_ERROR( USAGE );
       }   
     } else if ( strcmp( "-d", argv[ i ] ) == 0 ) {
       printDict = true;
       continue;
+    } else if ( strcmp( "-j", argv[ i ] ) == 0 ) {
+      if ( i + 1 < inFile && sscanf( argv[ i + 1 ], "%d", &threads ) == 1 &&
+           threads > 0 && threads <= MAX_THREADS ) {
+        i++;
+        continue;
+      } else {
+        USAGE_ERROR( USAGE );
+      }
+    } else if ( strcmp( "-H", argv[ i ] ) == 0 ) {
+      header = true;
+      continue;
+    } else if ( strcmp( "-v", argv[ i ] ) == 0 ) {
+      variable = true;
+      continue;
+    } else if ( strcmp( "-s", argv[ i ] ) == 0 ) {
+      stats = true;
+      continue;
+    } else if ( strcmp( "--stream", argv[ i ] ) == 0 ) {
+      stream = true;
+      continue;
+    } else if ( strcmp( "--pipeline", argv[ i ] ) == 0 ) {
+      pipeline = true;
+      continue;
+    } else if ( strcmp( "--huffman", argv[ i ] ) == 0 ) {
+      huffman = true;
+      continue;
+    } else if ( strcmp( "--max-dict-mem", argv[ i ] ) == 0 ) {
+      if ( i + 1 < inFile && sscanf( argv[ i + 1 ], "%ld", &memArg ) == 1 && memArg > 0 ) {
+        i++;
+        continue;
+      } else {
+        USAGE_ERROR( USAGE );
+      }
+    } else if ( strcmp( "--checkpoint", argv[ i ] ) == 0 ) {
+      if ( i + 1 < inFile && sscanf( argv[ i + 1 ], "%d", &checkpoint ) == 1 &&
+           checkpoint > 0 ) {
+        i++;
+        continue;
+      } else {
+        USAGE_ERROR( USAGE );
+      }
+    } else if ( strcmp( "-D", argv[ i ] ) == 0 && i + 1 < inFile ) {
+      dictFile = argv[ ++i ];
+      continue;
+    } else if ( strcmp( "--train", argv[ i ] ) == 0 ) {
+      train = true;
+      continue;
+    } else if ( strcmp( "--batch", argv[ i ] ) == 0 && i + 1 < inFile ) {
+      i++;
+      continue;
     } else {
-        USAGE_ERROR( "deflate" );
+        USAGE_ERROR( USAGE );
     }
   }
   
-  d = makeDictionary( bitArg );
-  Buffer *inBuffer = loadBuffer( argv[ inFile ] );
-  Buffer *outBuffer = makeBuffer();
+  // Each file of a batch is compressed whole, with -j files at a time
+  if ( manifest && ( checkpoint || stream || pipeline || printDict || autoBits || train ||
+                     stats ) ) {
+    USAGE_ERROR( USAGE );
+  }
 
-  outBuffer = deflate( d, inBuffer, bitArg );
-  freeBuffer( inBuffer );
+  // Blocks each get their own dictionary and are read and written whole
+  bool container = ( threads && !manifest ) || checkpoint;
+  if ( container && ( stream || printDict || variable || header ) ) {
+    USAGE_ERROR( USAGE );
+  }
 
-  saveBuffer( outBuffer, argv[ outFile ] );
-  freeBuffer( outBuffer );
+  // Trying each width needs the whole input, and the width goes in a header
+  if ( autoBits && ( container || stream || printDict ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  // Variable width codes need room for the clear code after the single bytes
+  if ( variable && bitArg < VAR_MIN_BITS ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  // A trained dictionary brings its own width, and blocks start out empty
+  if ( dictFile && ( bitsGiven || variable || autoBits || container || train ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  // Training just fills a dictionary from the sample and saves it
+  if ( train && ( header || autoBits || container || stream ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  // The pipeline streams its input, so it's a replacement for --stream
+  if ( pipeline && ( stream || container || autoBits || train ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  // Only a dictionary that learns as it goes can evict, and blocks and
+  // -b auto make their own
+  if ( memArg && ( dictFile || train || container || autoBits ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  // The Huffman code is built from all the codes and carried in the header,
+  // so the whole input is needed before anything is written, and inflate
+  // can only tell the codes are in it from a header
+  if ( huffman && ( !header || stream || pipeline || container || autoBits || train ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  if ( manifest ) {
+    BatchOptions o = { bitArg, variable, header, dictFile, memArg, huffman };
+    runBatch( manifest, threads ? threads : 1, makeBatchContext, deflateBatchFile, &o );
+    return ( EXIT_SUCCESS );
+  }
+
+  // Runs that use more than one context only have their time reported
+  Stats s;
+  startStats( &s );
+  if ( autoBits || container ) {
+    if ( autoBits ) {
+      deflateAuto( argv[ inFile ], argv[ outFile ], variable );
+    } else {
+      deflateBlocks( argv[ inFile ], argv[ outFile ], bitArg, threads ? threads : 1,
+                     checkpoint ? checkpoint : BLOCK_SIZE );
+    }
+    endPhase( &s, PHASE_CODE );
+    if ( stats ) {
+      printStats( &s, NULL );
+    }
+    return ( EXIT_SUCCESS );
+  }
+
+  LZW *z = lzwMake( bitArg, variable, header );
+  z->huffman = huffman;
+  if ( dictFile && !lzwUseDictionary( z, dictFile ) ) {
+    DICTIONARY_ERROR( dictFile );
+  }
+  if ( memArg && !lzwLimitMemory( z, memArg ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  if ( train ) {
+    trainDictionary( z, argv[ inFile ], argv[ outFile ] );
+    endPhase( &s, PHASE_CODE );
+  } else if ( stream || pipeline ) {
+    // Reading and writing are mixed in with compressing
+    FILE *in = openStream( argv[ inFile ], "rb" );
+    FILE *out = openStream( argv[ outFile ], "wb" );
+
+    if ( pipeline ) {
+      deflatePipeline( z, in, out );
+    } else {
+      lzwDeflateStream( z, in, out );
+    }
+    s.packedBytes = streamBytes( out );
+    closeStream( in );
+    closeStream( out );
+    endPhase( &s, PHASE_CODE );
+  } else {
+    Buffer *inBuffer = loadBuffer( argv[ inFile ] );
+    endPhase( &s, PHASE_READ );
+    Buffer *outBuffer = lzwDeflate( z, inBuffer->data, inBuffer->len );
+    freeBuffer( inBuffer );
+    endPhase( &s, PHASE_CODE );
+
+    saveBuffer( outBuffer, argv[ outFile ] );
+    endPhase( &s, PHASE_WRITE );
+    s.packedBytes = outBuffer->len;
+    freeBuffer( outBuffer );
+  }
 
   if ( printDict ) {
-    reportDictionary( d );
+    reportDictionary( z->d );
+  }
+
+  if ( stats ) {
+    printStats( &s, z );
   }
 
-  freeDictionary( d );
+  lzwFree( z );
   return ( EXIT_SUCCESS );
 }
\ No newline at end of file
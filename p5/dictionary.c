@@ -8,38 +8,343 @@
 */
 
 #include "dictionary.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/** Multiplier for Fibonacci hashing of ( prefix, byte ) keys */
+#define HASH_MULT 0x9E3779B97F4A7C15ULL
+/** Shift that keeps the well-mixed high half of a hashed key */
+#define HASH_SHIFT 32
+/** Number of bits a prefix code is shifted by to make room for the next byte */
+#define BYTE_SHIFT 8
+/** Learned words are taken out one at a time on a reset when there are fewer
+    than one for every this many hash slots */
+#define RESET_RATIO 4
+
+/** Stored in a saved dictionary to tell whether it was written with this
+    machine's byte order */
+#define DICT_ORDER 0x01020304
+
+/** Start of a saved dictionary. It's followed by the wordLen, wordPrefix and
+    hash table arrays, then wordLast. Everything is in the machine's own byte
+    order, so the arrays can be copied straight out of the mapped file. */
+typedef struct {
+  /** DICT_MAGIC. */
+  char magic[ DICT_MAGIC_LEN ];
+  /** DICT_ORDER, as this machine stores it. */
+  int order;
+  /** Number of bits in each code. */
+  int bits;
+  /** Number of entries. */
+  int length;
+  /** Number of slots in the hash table. */
+  long hashSize;
+} DictFile;
+
+/* Picks the first slot to probe for a ( prefix, byte ) key.
+
+   @param d is the dictionary whose hash table is being probed.
+   @param prefix is the code of the word being extended.
+   @param ch is the byte added to the end of the prefix word.
+   @return the index of the starting slot.
+*/
+static long hashSlot( Dictionary *d, int prefix, char ch )
+{
+  unsigned long long key = ( ( unsigned long long ) prefix << BYTE_SHIFT ) | ( unsigned char ) ch;
+  return ( long ) ( ( key * HASH_MULT ) >> HASH_SHIFT ) & ( d->hashSize - 1 );
+}
+
+/* Puts the given code in the first free slot for its key. Single-byte words
+   are never stored, since their code is just the byte value.
+
+   @param d is the dictionary whose hash table is being filled.
+   @param code is the code of the entry being inserted.
+*/
+static void hashInsert( Dictionary *d, int code )
+{
+  long slot = hashSlot( d, d->wordPrefix[ code ], d->wordLast[ code ] );
+
+  while ( d->hashTable[ slot ] != NO_CODE ) {
+    slot = ( slot + 1 ) & ( d->hashSize - 1 );
+  }
+  d->hashTable[ slot ] = code;
+}
+
+/* Takes a code back out of the hash table. Codes are always inserted in
+   increasing order, and nothing after a code has been inserted can move it,
+   so taking codes out newest first leaves the table just as it was before
+   they went in.
+
+   @param d is the dictionary whose hash table is being emptied.
+   @param code is the newest code still in the table.
+*/
+static void hashRemove( Dictionary *d, int code )
+{
+  long slot = hashSlot( d, d->wordPrefix[ code ], d->wordLast[ code ] );
+
+  while ( d->hashTable[ slot ] != code ) {
+    slot = ( slot + 1 ) & ( d->hashSize - 1 );
+  }
+  d->hashTable[ slot ] = NO_CODE;
+}
+
+/* Takes any code out of the hash table, moving later codes in its probe
+   sequence back so every code can still be found from its first slot.
+
+   @param d is the dictionary whose hash table is being changed.
+   @param code is the code being taken out.
+*/
+static void hashDelete( Dictionary *d, int code )
+{
+  long mask = d->hashSize - 1;
+  long hole = hashSlot( d, d->wordPrefix[ code ], d->wordLast[ code ] );
+
+  while ( d->hashTable[ hole ] != code ) {
+    hole = ( hole + 1 ) & mask;
+  }
+
+  // A later code can fill the hole if its first slot isn't between the hole
+  // and where it is now
+  for ( long slot = ( hole + 1 ) & mask; d->hashTable[ slot ] != NO_CODE; slot = ( slot + 1 ) & mask ) {
+    int next = d->hashTable[ slot ];
+    long home = hashSlot( d, d->wordPrefix[ next ], d->wordLast[ next ] );
+    if ( ( ( slot - home ) & mask ) >= ( ( slot - hole ) & mask ) ) {
+      d->hashTable[ hole ] = next;
+      hole = slot;
+    }
+  }
+  d->hashTable[ hole ] = NO_CODE;
+}
+
+/* Takes a learned entry out of the order entries were last used in.
+
+   @param d is the dictionary that evicts words.
+   @param code is the entry being taken out.
+*/
+static void lruUnlink( Dictionary *d, int code )
+{
+  if ( d->older[ code ] != NO_CODE ) {
+    d->newer[ d->older[ code ] ] = d->newer[ code ];
+  } else {
+    d->oldest = d->newer[ code ];
+  }
+
+  if ( d->newer[ code ] != NO_CODE ) {
+    d->older[ d->newer[ code ] ] = d->older[ code ];
+  } else {
+    d->newest = d->older[ code ];
+  }
+}
+
+/* Makes a learned entry the most recently used one.
+
+   @param d is the dictionary that evicts words.
+   @param code is the entry that was used, either newly added or already
+          in the order.
+   @param added is true if the entry is new, so isn't in the order yet.
+*/
+static void lruTouch( Dictionary *d, int code, bool added )
+{
+  if ( !added ) {
+    if ( code == d->newest ) {
+      return;
+    }
+    lruUnlink( d, code );
+  }
+
+  d->older[ code ] = d->newest;
+  d->newer[ code ] = NO_CODE;
+  if ( d->newest != NO_CODE ) {
+    d->newer[ d->newest ] = code;
+  } else {
+    d->oldest = code;
+  }
+  d->newest = code;
+}
+
+/* Evicts the least recently used learned word that no other word extends.
+   Words that are extended are passed over and made the most recently used,
+   since they're used every time one of the words extending them is, so they
+   aren't looked at again for a while.
+
+   @param d is the dictionary that evicts words.
+   @param prefix is the code of the word about to be extended, which can't
+          be evicted.
+   @return the code that was freed, or NO_CODE if no word could be evicted.
+*/
+static int evictWord( Dictionary *d, int prefix )
+{
+  int code = d->oldest;
+
+  for ( int left = d->dictLength - d->baseLength; code != NO_CODE && left > 0; left-- ) {
+    int next = d->newer[ code ];
+
+    if ( d->children[ code ] == 0 && code != prefix ) {
+      hashDelete( d, code );
+      lruUnlink( d, code );
+      if ( d->wordPrefix[ code ] >= d->baseLength ) {
+        d->children[ d->wordPrefix[ code ] ]--;
+      }
+      d->wordPrefix[ code ] = NO_CODE;
+      return code;
+    }
+
+    lruTouch( d, code, false );
+    code = next;
+  }
+  return NO_CODE;
+}
+
+/* Sets up a dictionary that doesn't evict words.
+
+   @param d is the newly made dictionary.
+*/
+static void initEviction( Dictionary *d )
+{
+  d->evict = false;
+  d->children = NULL;
+  d->older = NULL;
+  d->newer = NULL;
+  d->oldest = NO_CODE;
+  d->newest = NO_CODE;
+  d->roomMade = false;
+  d->spare = NO_CODE;
+}
+
+/* Empties the hash table and inserts every multi-byte entry below the given
+   code, in order. The clear code has no prefix and isn't stored.
+
+   @param d is the dictionary whose hash table is being rebuilt.
+   @param limit is the code to stop before.
+*/
+static void rebuildHash( Dictionary *d, int limit )
+{
+  FOR( i, d->hashSize )
+    d->hashTable[ i ] = NO_CODE;
+
+  for ( int i = MIN_DICT_SIZE; i < limit; i++ ) {
+    if ( d->wordPrefix[ i ] != NO_CODE ) {
+      hashInsert( d, i );
+    }
+  }
+}
+
+/* Doubles the hash table and reinserts every multi-byte entry.
+
+   @param d is the dictionary whose hash table is growing.
+*/
+static void growHash( Dictionary *d )
+{
+  free( d->hashTable );
+  d->hashSize *= 2;
+  d->hashTable = ( int * ) malloc( d->hashSize * sizeof( int ) );
+  rebuildHash( d, d->dictLength );
+}
 
 Dictionary *makeDictionary( int bits )
 {
   Dictionary *dictionary = ( Dictionary * ) malloc( sizeof( Dictionary ) );
 
-  long size = pow( BASE, bits );
+  long size = ( long ) 1 << bits;
 
-  // Fill the base dictionary
+  // Only allocate room for the entries we expect to use, the arrays grow later
   dictionary->dictSize = size;
   dictionary->dictLength = MIN_DICT_SIZE;
-  dictionary->wordList = ( char ** ) malloc( size * sizeof( char * ) );
-  dictionary->wordLen = ( int * ) malloc( size * sizeof( int ));
+  dictionary->baseLength = MIN_DICT_SIZE;
+  dictionary->dictCap = size < INIT_DICT_CAP ? size : INIT_DICT_CAP;
+  dictionary->wordLen = ( int * ) malloc( dictionary->dictCap * sizeof( int ) );
+  dictionary->wordPrefix = ( int * ) malloc( dictionary->dictCap * sizeof( int ) );
+  dictionary->wordLast = ( char * ) malloc( dictionary->dictCap * sizeof( char ) );
 
+  // Fill the base dictionary
   for ( int j = 0; j < MIN_DICT_SIZE; j++ ) {
-    dictionary->wordList[ j ] = ( char * ) malloc( sizeof( char ) );
     dictionary->wordLen[ j ] = 1;
-    dictionary->wordList[ j ][ 0 ] = ( char ) j;
+    dictionary->wordPrefix[ j ] = NO_CODE;
+    dictionary->wordLast[ j ] = ( char ) j;
   }
 
+  // Start with a small hash table, it doubles as entries are added
+  dictionary->hashSize = INIT_HASH_SIZE;
+  dictionary->hashTable = ( int * ) malloc( INIT_HASH_SIZE * sizeof( int ) );
+  FOR( j, INIT_HASH_SIZE )
+    dictionary->hashTable[ j ] = NO_CODE;
+
+  dictionary->lookups = 0;
+  dictionary->probes = 0;
+  initEviction( dictionary );
   return dictionary;
 }
 
 void freeDictionary( Dictionary *d )
 {
-  FOR( i, d->dictLength )
-    free( d->wordList[ i ] );
-
-  free( d->wordList );
   free( d->wordLen );
+  free( d->wordPrefix );
+  free( d->wordLast );
+  free( d->hashTable );
+  free( d->children );
+  free( d->older );
+  free( d->newer );
   free( d );
 }
 
+void limitDictionary( Dictionary *d, long entries )
+{
+  if ( entries < d->dictSize ) {
+    d->dictSize = entries;
+    d->dictCap = d->dictCap < entries ? d->dictCap : entries;
+  }
+
+  if ( !d->evict ) {
+    d->evict = true;
+    d->children = ( int * ) malloc( d->dictCap * sizeof( int ) );
+    d->older = ( int * ) malloc( d->dictCap * sizeof( int ) );
+    d->newer = ( int * ) malloc( d->dictCap * sizeof( int ) );
+  }
+}
+
+void addClearCode( Dictionary *d )
+{
+  // An empty word can't be the prefix of anything, so it's never matched
+  d->wordLen[ CLEAR_CODE ] = 0;
+  d->wordPrefix[ CLEAR_CODE ] = NO_CODE;
+  d->wordLast[ CLEAR_CODE ] = 0;
+  d->dictLength = CLEAR_CODE + 1;
+  d->baseLength = CLEAR_CODE + 1;
+}
+
+void resetDictionary( Dictionary *d )
+{
+  // Taking out a few words is cheaper than refilling the whole table, which
+  // matters when a trained dictionary is reset for every small message
+  // Evicted codes come back out of order, so there's no undoing them one by one
+  if ( !d->evict &&
+       ( long ) ( d->dictLength - d->baseLength ) * RESET_RATIO < d->hashSize ) {
+    for ( int code = d->dictLength - 1; code >= d->baseLength; code-- ) {
+      if ( d->wordPrefix[ code ] != NO_CODE ) {
+        hashRemove( d, code );
+      }
+    }
+  } else {
+    rebuildHash( d, d->baseLength );
+  }
+
+  d->dictLength = d->baseLength;
+  d->oldest = NO_CODE;
+  d->newest = NO_CODE;
+  d->roomMade = false;
+}
+
+int codeWidth( long codes )
+{
+  int width = VAR_MIN_BITS;
+  while ( ( ( long ) 1 << width ) < codes ) {
+    width++;
+  }
+  return width;
+}
+
 void printWord( char *word, int len )
 {
   FOR( i, len )
@@ -52,38 +357,266 @@ void printWord( char *word, int len )
 
 void reportDictionary( Dictionary *d )
 {
-  for ( int i = MIN_DICT_SIZE; i < d->dictLength; i++ ) {
+  // Find the longest word so one scratch array can hold any of them
+  int maxLen = 1;
+  for ( int i = d->baseLength; i < d->dictLength; i++ ) {
+    maxLen = d->wordLen[ i ] > maxLen ? d->wordLen[ i ] : maxLen;
+  }
+  char *word = ( char * ) malloc( maxLen * sizeof( char ) );
+
+  for ( int i = d->baseLength; i < d->dictLength; i++ ) {
     printf( "%4d ", i );
-    printWord( d->wordList[ i ], d->wordLen[ i ] );
+    printWord( word, getWord( d, i, word ) );
     printf( "\n" );
   }
+
+  free( word );
+}
+
+int getWord( Dictionary *d, int code, char *dest )
+{
+  int len = d->wordLen[ code ];
+
+  for ( int i = len - 1; i >= 0; i-- ) {
+    dest[ i ] = d->wordLast[ code ];
+    code = d->wordPrefix[ code ];
+  }
+  return len;
 }
 
 int lookupWord( Dictionary *d, char *word, int len )
 {
-  FOR( i, d->dictLength ) {
-    if ( d->wordLen[ i ] == len ) {
-      if ( memcmp( d->wordList[ i ], word, len ) == 0 ) {
-        int dictPick = i;
-        return dictPick;
+  if ( len < 1 ) {
+    return -1;
+  }
+
+  int code = ( unsigned char ) word[ 0 ];
+  for ( int i = 1; i < len && code != NO_CODE; i++ ) {
+    code = findChild( d, code, word[ i ] );
+  }
+  return code;
+}
+
+void addWord( Dictionary *d, char *word, int len )
+{
+  int prefix = lookupWord( d, word, len - 1 );
+  
+  if ( prefix != NO_CODE ) {
+    addChild( d, prefix, word[ len - 1 ] );
+  }
+}
+
+int findChild( Dictionary *d, int prefix, char ch )
+{
+  long slot = hashSlot( d, prefix, ch );
+
+  // Linear probing, stop at the first empty slot
+  d->lookups++;
+  d->probes++;
+  for ( int code = d->hashTable[ slot ]; code != NO_CODE; code = d->hashTable[ slot ] ) {
+    if ( d->wordPrefix[ code ] == prefix && d->wordLast[ code ] == ch ) {
+      return code;
+    }
+    slot = ( slot + 1 ) & ( d->hashSize - 1 );
+    d->probes++;
+  }
+  return NO_CODE;
+}
+
+int makeRoom( Dictionary *d, int prefix )
+{
+  if ( !d->roomMade ) {
+    if ( d->dictLength < d->dictSize ) {
+      d->spare = d->dictLength;
+    } else {
+      d->spare = d->evict ? evictWord( d, prefix ) : NO_CODE;
+    }
+    d->roomMade = true;
+  }
+  return d->spare;
+}
+
+int addChild( Dictionary *d, int prefix, char ch )
+{
+  if ( d->dictLength == d->dictSize && !d->evict ) {
+    return NO_CODE;
+  }
+
+  int code = makeRoom( d, prefix );
+  d->roomMade = false;
+  if ( code == NO_CODE ) {
+    return NO_CODE;
+  }
+
+  if ( code == d->dictLength ) {
+    // Keep the table at most half full so probe sequences stay short
+    if ( ( long ) ( d->dictLength - MIN_DICT_SIZE + 1 ) * 2 > d->hashSize ) {
+      growHash( d );
+    }
+
+    // Grow the entry arrays geometrically, never past the largest code
+    if ( d->dictLength == d->dictCap ) {
+      d->dictCap = d->dictCap * 2 < d->dictSize ? d->dictCap * 2 : d->dictSize;
+      d->wordLen = ( int * ) realloc( d->wordLen, d->dictCap * sizeof( int ) );
+      d->wordPrefix = ( int * ) realloc( d->wordPrefix, d->dictCap * sizeof( int ) );
+      d->wordLast = ( char * ) realloc( d->wordLast, d->dictCap * sizeof( char ) );
+      if ( d->evict ) {
+        d->children = ( int * ) realloc( d->children, d->dictCap * sizeof( int ) );
+        d->older = ( int * ) realloc( d->older, d->dictCap * sizeof( int ) );
+        d->newer = ( int * ) realloc( d->newer, d->dictCap * sizeof( int ) );
+      }
+    }
+    d->dictLength++;
+  }
+
+  d->wordLen[ code ] = d->wordLen[ prefix ] + 1;
+  d->wordPrefix[ code ] = prefix;
+  d->wordLast[ code ] = ch;
+  hashInsert( d, code );
+
+  if ( d->evict ) {
+    d->children[ code ] = 0;
+    if ( prefix >= d->baseLength ) {
+      d->children[ prefix ]++;
+      lruTouch( d, prefix, false );
+    }
+    lruTouch( d, code, true );
+  }
+  return code;
+}
+
+bool saveDictionary( Dictionary *d, char const *filename )
+{
+  FILE *fp = fopen( filename, "wb" );
+  if ( !fp ) {
+    return false;
+  }
+
+  DictFile head = { DICT_MAGIC, DICT_ORDER, 0, d->dictLength, d->hashSize };
+  while ( ( ( long ) 1 << head.bits ) < d->dictSize ) {
+    head.bits++;
+  }
+
+  fwrite( &head, sizeof( head ), 1, fp );
+  fwrite( d->wordLen, sizeof( int ), d->dictLength, fp );
+  fwrite( d->wordPrefix, sizeof( int ), d->dictLength, fp );
+  fwrite( d->hashTable, sizeof( int ), d->hashSize, fp );
+  fwrite( d->wordLast, sizeof( char ), d->dictLength, fp );
+
+  bool ok = !ferror( fp );
+  return fclose( fp ) == 0 && ok;
+}
+
+/* Checks that the arrays of a saved dictionary hold words that can be
+   rebuilt and a hash table whose probes always end.
+
+   @param head is the start of the saved dictionary.
+   @param wordLen is the saved wordLen array.
+   @param wordPrefix is the saved wordPrefix array.
+   @param hashTable is the saved hash table.
+   @param wordLast is the saved wordLast array.
+   @return true if the dictionary can be used. Otherwise, returns false.
+*/
+static bool checkSaved( DictFile const *head, int const *wordLen, int const *wordPrefix,
+                        int const *hashTable, char const *wordLast )
+{
+  FOR( i, head->length ) {
+    bool single = i < MIN_DICT_SIZE;
+    bool clear = i == CLEAR_CODE && wordLen[ i ] == 0;
+
+    if ( single && ( wordLen[ i ] != 1 || wordPrefix[ i ] != NO_CODE ||
+                     wordLast[ i ] != ( char ) i ) ) {
+      return false;
+    }
+    if ( clear && wordPrefix[ i ] != NO_CODE ) {
+      return false;
+    }
+
+    // A learned word extends an earlier word that isn't the clear code
+    if ( !single && !clear ) {
+      int prefix = wordPrefix[ i ];
+      if ( prefix < 0 || prefix >= i || wordLen[ prefix ] < 1 ||
+           wordLen[ i ] != wordLen[ prefix ] + 1 ) {
+        return false;
+      }
+    }
+  }
+
+  long used = 0;
+  FOR( i, head->hashSize ) {
+    int code = hashTable[ i ];
+    if ( code != NO_CODE ) {
+      if ( code < MIN_DICT_SIZE || code >= head->length || wordPrefix[ code ] == NO_CODE ) {
+        return false;
       }
+      used++;
     }
   }
-  return -1;
+
+  return used < head->hashSize;
 }
 
-void addWord( Dictionary *d, char *word, int len )
+Dictionary *loadDictionary( char const *filename )
 {
-  if ( d->dictSize == d->dictLength ) {
-    return;
+  int fd = open( filename, O_RDONLY );
+  if ( fd == -1 ) {
+    return NULL;
   }
-  
-  d->wordList[ d->dictLength ] = ( char * ) malloc( len *  sizeof( char ) );
 
-  FOR( i, len ) {
-    d->wordList[ d->dictLength ][ i ] = word[ i ];
+  struct stat info;
+  if ( fstat( fd, &info ) == -1 || info.st_size < ( long ) sizeof( DictFile ) ) {
+    close( fd );
+    return NULL;
   }
-  
-  d->wordLen[ d->dictLength ] = len;
-  d->dictLength++;
-}
\ No newline at end of file
+
+  char *map = mmap( NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if ( map == MAP_FAILED ) {
+    return NULL;
+  }
+
+  DictFile head;
+  memcpy( &head, map, sizeof( head ) );
+
+  // The header has to describe exactly what follows it
+  bool ok = memcmp( head.magic, DICT_MAGIC, DICT_MAGIC_LEN ) == 0 && head.order == DICT_ORDER &&
+            head.bits >= MINIMUM_BITS && head.bits <= MAXIMUM_BITS &&
+            head.length >= MIN_DICT_SIZE && head.length <= ( ( long ) 1 << head.bits ) &&
+            head.hashSize >= INIT_HASH_SIZE && ( head.hashSize & ( head.hashSize - 1 ) ) == 0 &&
+            head.hashSize <= info.st_size &&
+            info.st_size == ( long ) ( sizeof( head ) + head.length * ( 2 * sizeof( int ) + 1 ) +
+                                       head.hashSize * sizeof( int ) );
+
+  int const *wordLen = ( int const * ) ( map + sizeof( head ) );
+  int const *wordPrefix = wordLen + ( ok ? head.length : 0 );
+  int const *hashTable = wordPrefix + ( ok ? head.length : 0 );
+  char const *wordLast = ( char const * ) ( hashTable + ( ok ? head.hashSize : 0 ) );
+
+  if ( !ok || !checkSaved( &head, wordLen, wordPrefix, hashTable, wordLast ) ) {
+    munmap( map, info.st_size );
+    return NULL;
+  }
+
+  Dictionary *d = ( Dictionary * ) malloc( sizeof( Dictionary ) );
+  d->dictSize = ( long ) 1 << head.bits;
+  d->dictLength = head.length;
+  d->baseLength = head.length;
+  d->dictCap = head.length;
+  d->hashSize = head.hashSize;
+
+  d->wordLen = ( int * ) malloc( d->dictCap * sizeof( int ) );
+  d->wordPrefix = ( int * ) malloc( d->dictCap * sizeof( int ) );
+  d->wordLast = ( char * ) malloc( d->dictCap * sizeof( char ) );
+  d->hashTable = ( int * ) malloc( d->hashSize * sizeof( int ) );
+
+  memcpy( d->wordLen, wordLen, d->dictCap * sizeof( int ) );
+  memcpy( d->wordPrefix, wordPrefix, d->dictCap * sizeof( int ) );
+  memcpy( d->wordLast, wordLast, d->dictCap * sizeof( char ) );
+  memcpy( d->hashTable, hashTable, d->hashSize * sizeof( int ) );
+
+  d->lookups = 0;
+  d->probes = 0;
+  initEviction( d );
+  munmap( map, info.st_size );
+  return d;
+}
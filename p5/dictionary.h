@@ -7,7 +7,6 @@
     file.
 */
 
-#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -17,8 +16,6 @@
 #ifndef _DICTIONARY_H_
 #define _DICTIONARY_H_
 
-/** Base for bits */
-#define BASE 2
 /** Minimum number of bits for a dictionary index. */
 #define MINIMUM_BITS 8
 /** Maximum number of bits for a dictionary index. */
@@ -27,17 +24,76 @@
 #define DEFAULT_BITS 10
 /** Initial half of the Dictionary */
 #define MIN_DICT_SIZE 256
+/** Code that tells inflate to reset the dictionary, when code widths vary */
+#define CLEAR_CODE 256
+/** Width of the first codes written when code widths vary */
+#define VAR_MIN_BITS 9
+/** Number of entries the dictionary arrays have room for when first made */
+#define INIT_DICT_CAP 1024
+/** Initial number of slots in the dictionary hash table */
+#define INIT_HASH_SIZE 1024
+/** Marker for an empty slot in the dictionary hash table */
+#define NO_CODE -1
+/** Most bytes of memory one entry can take: its word arrays, its share of a
+    hash table that's at least a quarter full, its place in the eviction
+    order and inflate's record of where its word appears */
+#define DICT_ENTRY_BYTES ( 9 * sizeof( int ) + sizeof( char ) + sizeof( long ) )
+/** Fewest entries a dictionary that evicts words may be limited to */
+#define MIN_DICT_ENTRIES 512
 
+/** Magic number at the start of a saved dictionary */
+#define DICT_MAGIC "\x89" "LZD"
+/** Number of bytes in the magic number */
+#define DICT_MAGIC_LEN 4
+/** Error for a dictionary file that can't be used */
+#define DICTIONARY_ERROR( filename ) { fprintf( stderr, "Invalid dictionary: %s\n", filename ); exit( 1 ); }
 /** Macro for a for-loop */
 #define FOR( var, limit ) for ( int var = 0; var < limit; var++ )
 
-/** Dictionary structure */
+/** Dictionary structure. Each entry is stored as the code of the word it
+    extends plus its last byte, so a word is rebuilt by walking its prefix chain.
+    The entry arrays grow with the number of entries used, not with 2^bits. */
 typedef struct
 {
+    /** Maximum number of entries, 2^bits */
     long dictSize;
     int dictLength;
-    char **wordList;
+    /** Number of entries the dictionary starts with and is reset to */
+    int baseLength;
+    /** Number of entries the entry arrays currently have room for */
+    long dictCap;
     int *wordLen;
+    /** Code of the word each entry extends by one byte, NO_CODE for single bytes */
+    int *wordPrefix;
+    /** Last byte of each entry */
+    char *wordLast;
+    /** Open-addressed table of codes, keyed on ( prefix code, next byte ) */
+    int *hashTable;
+    /** Number of slots in hashTable, always a power of two */
+    long hashSize;
+    /** True if a full dictionary evicts its least recently used word to make
+        room for a new one, instead of not learning it */
+    bool evict;
+    /** Number of words that extend each entry, when evicting */
+    int *children;
+    /** Next older learned entry in the order they were last used, when evicting */
+    int *older;
+    /** Next newer learned entry in the order they were last used, when evicting */
+    int *newer;
+    /** Least recently used learned entry, or NO_CODE */
+    int oldest;
+    /** Most recently used learned entry, or NO_CODE */
+    int newest;
+    /** True if makeRoom() has picked the code for the next entry */
+    bool roomMade;
+    /** Code makeRoom() picked for the next entry, or NO_CODE if there's no room */
+    int spare;
+    /** Number of times findChild() has been called, kept across resets for
+        -s */
+    long lookups;
+    /** Number of hash table slots findChild() has looked at, kept across
+        resets for -s */
+    long probes;
 } Dictionary;
 
 /* Creates the Dictionary object.
@@ -53,6 +109,41 @@ Dictionary *makeDictionary( int bits );
 */
 void freeDictionary( Dictionary *d );
 
+/* Reserves CLEAR_CODE as an entry that's never matched, so learned words
+   start after it. Used when code widths vary.
+
+   @param d is the newly made dictionary.
+*/
+void addClearCode( Dictionary *d );
+
+/* Limits the dictionary to the given number of entries, and makes it evict
+   the least recently used word that no other word extends whenever it's full
+   and a new word is added. A word is used each time it's extended into a new
+   word, which deflate and inflate both do with every code but the last, so
+   they evict the same words. Must be called while only the entries the
+   dictionary started with are in it.
+
+   @param d is the dictionary being limited.
+   @param entries is the most entries the dictionary may hold.
+*/
+void limitDictionary( Dictionary *d, long entries );
+
+/* Throws away every learned word, leaving only the entries the dictionary
+   started with. The entry arrays keep their size for reuse, and a reset
+   after only a few words costs only a few steps.
+
+   @param d is the dictionary being reset.
+*/
+void resetDictionary( Dictionary *d );
+
+/* Finds the width of code needed to hold every code below the given one,
+   never less than VAR_MIN_BITS.
+
+   @param codes is the number of codes that may be written.
+   @return the number of bits in each code.
+*/
+int codeWidth( long codes );
+
 /* Print out a word consisting of an arbitrary sequence of bytes
    (maybe including some non-ASCII codes and zeros).  It prints
    each byte using two characters, printing a symbol for visible
@@ -69,12 +160,23 @@ void printWord( char *word, int len );
 */
 void reportDictionary( Dictionary *d );
 
+/* Copies the word for the given code into dest by walking its prefix chain
+   from the last byte back to the first.
+
+   @param d is the dictionary holding the word.
+   @param code is the code of the word to copy.
+   @param dest is where the word is written, with room for at least wordLen[ code ] bytes.
+   @return the length of the word.
+*/
+int getWord( Dictionary *d, int code, char *dest );
+
 /* Looks up a the first occurrence of a word with the given length in the
-   given dictionary.
+   given dictionary by following the trie one byte at a time.
    
    @param d is the dictionary being searched.
    @param word being searched for in the dictionary.
    @param len is the length of the word to find in the dictionary.
+   @return the code for the word, or -1 if it isn't in the dictionary.
 */
 int lookupWord( Dictionary *d, char *word, int len );
 
@@ -86,4 +188,56 @@ int lookupWord( Dictionary *d, char *word, int len );
 */
 void addWord( Dictionary *d, char *word, int len );
 
+/* Finds the code for the word made by extending the word at prefix by one
+   byte. This is a single hash probe sequence, so deflate can walk the trie
+   one input byte at a time.
+
+   @param d is the dictionary being searched.
+   @param prefix is the code of the word being extended.
+   @param ch is the byte added to the end of the prefix word.
+   @return the code of the extended word, or NO_CODE if it isn't in the dictionary.
+*/
+int findChild( Dictionary *d, int prefix, char ch );
+
+/* Picks the code the next word made by extending prefix will get, making
+   room for it first if the dictionary evicts words. addChild() calls this
+   itself, but inflate calls it before decoding each code, since the code may
+   be for that very word.
+
+   @param d is the dictionary being amended.
+   @param prefix is the code of the word that will be extended.
+   @return the code of the next word, or NO_CODE if there's no room for it.
+*/
+int makeRoom( Dictionary *d, int prefix );
+
+/* Adds the word made by extending the word at prefix by one byte, if there
+   is space, or if a word can be evicted to make space.
+
+   @param d is the dictionary being amended.
+   @param prefix is the code of the word being extended.
+   @param ch is the byte added to the end of the prefix word.
+   @return the code of the new word, or NO_CODE if there's no room for it.
+*/
+int addChild( Dictionary *d, int prefix, char ch );
+
+/* Saves every entry of a dictionary to a file, so it can be loaded as a
+   trained dictionary that other inputs start from.
+
+   @param d is the dictionary being saved.
+   @param filename is the name of the file it's saved to.
+   @return true if the file was written. Otherwise, returns false.
+*/
+bool saveDictionary( Dictionary *d, char const *filename );
+
+/* Loads a dictionary saved by saveDictionary(). The file is mapped and its
+   arrays copied straight into place, so no words have to be added or hashed
+   again. Every entry in the file becomes part of what the dictionary is
+   reset to.
+
+   @param filename is the name of the saved dictionary.
+   @return the loaded dictionary, or NULL if the file couldn't be read or
+           isn't a dictionary saved on a machine like this one.
+*/
+Dictionary *loadDictionary( char const *filename );
+
 #endif
\ No newline at end of file
@@ -0,0 +1,117 @@
+/**
+   @file header.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The header file reads and writes the optional header at the start of a
+   compressed file.
+*/
+
+#include "header.h"
+#include "dictionary.h"
+#include <limits.h>
+
+void writeHeader( Buffer *buffer, Header const *h )
+{
+  for ( int i = 0; i < HEADER_MAGIC_LEN; i++ ) {
+    appendByte( buffer, HEADER_MAGIC[ i ] );
+  }
+  appendByte( buffer, ( char ) h->flags );
+  appendByte( buffer, ( char ) h->bits );
+  appendInt( buffer, h->length, LENGTH_BYTES );
+  if ( h->flags & FLAG_EVICT ) {
+    appendInt( buffer, h->entries, ENTRIES_BYTES );
+  }
+
+  // Code lengths fit in four bits, so they're stored two to a byte
+  if ( h->flags & FLAG_HUFFMAN ) {
+    for ( int i = 0; i < HUFF_SYMBOLS; i += 2 ) {
+      int low = i + 1 < HUFF_SYMBOLS ? h->lengths[ i + 1 ] : 0;
+      appendByte( buffer, ( char ) ( h->lengths[ i ] << 4 | low ) );
+    }
+    for ( int k = 0; k < HUFF_STREAMS - 1; k++ ) {
+      appendInt( buffer, h->sizes[ k ], HUFF_SIZE_BYTES );
+    }
+  }
+}
+
+bool hasHeader( char const *data, int len )
+{
+  return len >= HEADER_MAGIC_LEN && memcmp( data, HEADER_MAGIC, HEADER_MAGIC_LEN ) == 0;
+}
+
+int headerLength( char const *data )
+{
+  int flags = ( unsigned char ) data[ HEADER_MAGIC_LEN ];
+  return HEADER_LEN + ( ( flags & FLAG_EVICT ) ? ENTRIES_BYTES : 0 ) +
+         ( ( flags & FLAG_HUFFMAN ) ? HUFF_HEADER_BYTES : 0 );
+}
+
+bool readHeader( char const *data, long len, int longest, Header *h )
+{
+  if ( ( len != UNKNOWN_LEN && len < HEADER_LEN ) || !hasHeader( data, HEADER_LEN ) ) {
+    return false;
+  }
+
+  h->flags = ( unsigned char ) data[ HEADER_MAGIC_LEN ];
+  h->bits = ( unsigned char ) data[ HEADER_MAGIC_LEN + 1 ];
+  h->length = ( long ) readInt( data + HEADER_MAGIC_LEN + 2, LENGTH_BYTES );
+
+  int minBits = ( h->flags & FLAG_VARIABLE ) ? VAR_MIN_BITS : MINIMUM_BITS;
+  if ( ( h->flags & ~KNOWN_FLAGS ) || h->bits < minBits || h->bits > MAXIMUM_BITS ||
+       h->length < UNKNOWN_LEN ) {
+    return false;
+  }
+
+  // The entry limit, code lengths and stream sizes follow the fixed part of the header
+  int size = headerLength( data );
+  if ( len != UNKNOWN_LEN && len < size ) {
+    return false;
+  }
+
+  int pos = HEADER_LEN;
+  h->entries = 0;
+  if ( h->flags & FLAG_EVICT ) {
+    h->entries = ( long ) readInt( data + pos, ENTRIES_BYTES );
+    if ( h->entries < MIN_DICT_ENTRIES || h->entries > INT_MAX ) {
+      return false;
+    }
+    pos += ENTRIES_BYTES;
+  }
+
+  if ( h->flags & FLAG_HUFFMAN ) {
+    for ( int i = 0; i < HUFF_SYMBOLS; i++ ) {
+      unsigned char b = data[ pos + i / 2 ];
+      h->lengths[ i ] = i % 2 ? b & 0x0F : b >> 4;
+    }
+    if ( !validLengths( h->lengths ) ) {
+      return false;
+    }
+    pos += HUFF_TABLE_BYTES;
+
+    // The streams all have to fit in what's left
+    long streams = 0;
+    for ( int k = 0; k < HUFF_STREAMS - 1; k++ ) {
+      h->sizes[ k ] = ( long ) readInt( data + pos, HUFF_SIZE_BYTES );
+      streams += h->sizes[ k ];
+      pos += HUFF_SIZE_BYTES;
+    }
+    if ( len != UNKNOWN_LEN && streams > len - size ) {
+      return false;
+    }
+  }
+
+  // Each code adds a word one byte longer than one before it, so the k-th
+  // code decodes to at most longest + k - 1 bytes, and n codes give at most
+  // n * longest + n ( n - 1 ) / 2 bytes. A length past that can't be right.
+  // A Huffman code can be as short as a bit.
+  if ( len != UNKNOWN_LEN && h->length != UNKNOWN_LEN ) {
+    int codeBits = ( h->flags & FLAG_HUFFMAN ) ? 1 : minBits;
+    double codes = ( double ) ( len - size ) * BBITS / codeBits;
+    if ( h->length > codes * longest + codes * ( codes - 1 ) / 2 ||
+         ( h->length > 0 && codes < 1 ) ) {
+      return false;
+    }
+  }
+
+  return true;
+}
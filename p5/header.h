@@ -0,0 +1,102 @@
+/**
+   @file header.h
+   @author Stephen Gonsalves (dkgonsal)
+
+   The header file reads and writes the optional header at the start of a
+   compressed file. The header holds a magic number, flags for how the codes
+   were written, the code width and the length of the original input, so
+   inflate can check the file, pick the code width and size its output before
+   decoding anything. All numbers are stored high-order byte first.
+*/
+
+#ifndef _HEADER_H_
+#define _HEADER_H_
+
+#include "buffer.h"
+#include "huffman.h"
+
+/** Magic number at the start of a header. The first byte can't start a
+    headerless file written with more than 8 bits per code. */
+#define HEADER_MAGIC "\x89" "LZW"
+/** Number of bytes in the magic number */
+#define HEADER_MAGIC_LEN 4
+/** Number of bytes in a header */
+#define HEADER_LEN 14
+/** Number of bytes the original length is stored in */
+#define LENGTH_BYTES 8
+/** Stored in place of the original length when it wasn't known */
+#define UNKNOWN_LEN -1
+
+/** Number of bytes the entry limit is stored in, after the rest of the
+    header, when the dictionary evicts words */
+#define ENTRIES_BYTES 4
+
+/** Flag for codes whose width grows with the dictionary */
+#define FLAG_VARIABLE 0x01
+/** Flag for a dictionary limited to a number of entries, which evicts its
+    least recently used words once it's full */
+#define FLAG_EVICT 0x02
+/** Flag for codes written in a static Huffman code, whose code lengths
+    and stream sizes follow the rest of the header */
+#define FLAG_HUFFMAN 0x04
+/** Every flag this version understands */
+#define KNOWN_FLAGS ( FLAG_VARIABLE | FLAG_EVICT | FLAG_HUFFMAN )
+
+/** Error for a header that can't be used */
+#define HEADER_ERROR() { fprintf( stderr, "Invalid header\n" ); exit( 1 ); }
+
+/** Contents of a header. */
+typedef struct {
+  /** FLAG_ values describing how the codes were written. */
+  int flags;
+  /** Number of bits in each code, or the largest width when widths vary. */
+  int bits;
+  /** Number of bytes in the original input, or UNKNOWN_LEN. */
+  long length;
+  /** Most entries the dictionary held, when FLAG_EVICT is set. */
+  long entries;
+  /** Length of each symbol's Huffman code, when FLAG_HUFFMAN is set. */
+  unsigned char lengths[ HUFF_SYMBOLS ];
+  /** Number of bytes in each Huffman stream but the last, when FLAG_HUFFMAN
+      is set. */
+  long sizes[ HUFF_STREAMS - 1 ];
+} Header;
+
+/* Appends a header to the buffer.
+
+   @param buffer is the buffer the header is appended to.
+   @param h is the header being written.
+*/
+void writeHeader( Buffer *buffer, Header const *h );
+
+/* Checks whether data starts with the header magic number.
+
+   @param data is the start of the compressed file.
+   @param len is the number of bytes available.
+   @return true if the data starts with a header. Otherwise, returns false.
+*/
+bool hasHeader( char const *data, int len );
+
+/* Finds the number of bytes in the header at the start of data, from its
+   flags.
+
+   @param data is the start of a header, with at least HEADER_LEN bytes.
+   @return the number of bytes in the header.
+*/
+int headerLength( char const *data );
+
+/* Reads a header and checks it against the compressed data after it.
+
+   @param data is the start of the compressed file, including the header.
+          When len is UNKNOWN_LEN, it has to hold headerLength() bytes.
+   @param len is the number of bytes in the whole file, or UNKNOWN_LEN if it
+          isn't known yet.
+   @param longest is the number of bytes in the longest word the dictionary
+          starts with, which bounds how much the codes can decode to.
+   @param h is where the contents of the header are stored.
+   @return true if the header is something deflate could have written.
+           Otherwise, returns false.
+*/
+bool readHeader( char const *data, long len, int longest, Header *h );
+
+#endif
@@ -0,0 +1,455 @@
+/**
+   @file huffman.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The huffman file entropy codes a stream of LZW codes with a static Huffman
+   code, built once all the codes are known.
+*/
+
+#include "huffman.h"
+#include "unpack.h"
+
+/** Number of bits in a code that's a symbol of its own */
+#define LITERAL_BITS 8
+/** Number of low bits of a decoding table entry that hold the code length */
+#define LEN_BITS 4
+/** Mask for the code length in a decoding table entry */
+#define LEN_MASK ( ( 1 << LEN_BITS ) - 1 )
+/** Mask for the number of LZW code bits after the code, which come next in
+    a decoding table entry */
+#define EXTRA_MASK 0x1F
+/** Position of the symbol in a decoding table entry */
+#define SYMBOL_SHIFT ( LEN_BITS + 5 )
+/** Number of LZW codes there's room for at first */
+#define INITIAL_CODES 4096
+
+/* Finds the position of the highest one bit of a nonzero code.
+
+   @param code is the code.
+   @return the position, counting from 0 for the lowest bit.
+*/
+static inline int highBit( unsigned int code )
+{
+#if defined( __GNUC__ )
+  return 31 - __builtin_clz( code );
+#else
+  int n = 0;
+  while ( code >>= 1 ) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+/* Finds the symbol an LZW code is written with.
+
+   @param code is the LZW code.
+   @return its symbol.
+*/
+static inline int symbolOf( unsigned int code )
+{
+  if ( code < HUFF_LITERALS ) {
+    return code;
+  }
+
+  int n = highBit( code );
+  int group = ( code >> ( n - HUFF_GROUP_BITS ) ) & ( ( 1 << HUFF_GROUP_BITS ) - 1 );
+  return HUFF_LITERALS + ( ( n - LITERAL_BITS ) << HUFF_GROUP_BITS ) + group;
+}
+
+HuffCode *makeHuffCode()
+{
+  HuffCode *h = ( HuffCode * ) malloc( sizeof( HuffCode ) );
+
+  for ( int s = 0; s < HUFF_LITERALS; s++ ) {
+    h->base[ s ] = s;
+    h->extra[ s ] = 0;
+  }
+
+  // Each group is the codes with the same highest bits
+  for ( int g = 0; g < HUFF_GROUPS; g++ ) {
+    int n = LITERAL_BITS + ( g >> HUFF_GROUP_BITS );
+    unsigned int group = g & ( ( 1 << HUFF_GROUP_BITS ) - 1 );
+    h->base[ HUFF_LITERALS + g ] = ( 1U << n ) | ( group << ( n - HUFF_GROUP_BITS ) );
+    h->extra[ HUFF_LITERALS + g ] = n - HUFF_GROUP_BITS;
+  }
+
+  h->base[ HUFF_END ] = 0;
+  h->extra[ HUFF_END ] = 0;
+  memset( h->lengths, 0, sizeof( h->lengths ) );
+  for ( int k = 0; k < HUFF_STREAMS; k++ ) {
+    h->streams[ k ] = NULL;
+  }
+  h->ended = false;
+  h->plain = false;
+  h->cap = INITIAL_CODES;
+  h->count = 0;
+  h->plainBits = 0;
+  h->codes = ( unsigned int * ) malloc( h->cap * sizeof( unsigned int ) );
+  h->widths = ( unsigned char * ) malloc( h->cap );
+  return h;
+}
+
+void freeHuffCode( HuffCode *h )
+{
+  for ( int k = 0; k < HUFF_STREAMS; k++ ) {
+    if ( h->streams[ k ] ) {
+      freeBuffer( h->streams[ k ] );
+    }
+  }
+  free( h->codes );
+  free( h->widths );
+  free( h );
+}
+
+void collectCode( HuffCode *h, unsigned int code, int width )
+{
+  if ( h->count == h->cap ) {
+    h->cap *= 2;
+    h->codes = ( unsigned int * ) realloc( h->codes, h->cap * sizeof( unsigned int ) );
+    h->widths = ( unsigned char * ) realloc( h->widths, h->cap );
+  }
+  h->codes[ h->count ] = code;
+  h->widths[ h->count++ ] = width;
+  h->plainBits += width;
+}
+
+/* Works out the length of each symbol's Huffman code, by repeatedly joining
+   the two lightest trees. There are few enough symbols that finding them by
+   looking through every tree is quick.
+
+   @param weights is the number of times each symbol is used.
+   @param lengths is where the length of each symbol's code is stored.
+   @return the length of the longest code.
+*/
+static int huffmanLengths( long const *weights, unsigned char *lengths )
+{
+  long weight[ 2 * HUFF_SYMBOLS ];
+  int parent[ 2 * HUFF_SYMBOLS ];
+  bool open[ 2 * HUFF_SYMBOLS ];
+  int nodes = HUFF_SYMBOLS, trees = 0;
+
+  for ( int i = 0; i < HUFF_SYMBOLS; i++ ) {
+    weight[ i ] = weights[ i ];
+    parent[ i ] = -1;
+    open[ i ] = weights[ i ] > 0;
+    trees += open[ i ];
+  }
+
+  while ( trees > 1 ) {
+    int a = -1, b = -1;
+    for ( int i = 0; i < nodes; i++ ) {
+      if ( !open[ i ] ) {
+        continue;
+      }
+      if ( a < 0 || weight[ i ] < weight[ a ] ) {
+        b = a;
+        a = i;
+      } else if ( b < 0 || weight[ i ] < weight[ b ] ) {
+        b = i;
+      }
+    }
+
+    weight[ nodes ] = weight[ a ] + weight[ b ];
+    parent[ nodes ] = -1;
+    open[ nodes ] = true;
+    parent[ a ] = parent[ b ] = nodes;
+    open[ a ] = open[ b ] = false;
+    nodes++;
+    trees--;
+  }
+
+  int longest = 0;
+  for ( int i = 0; i < HUFF_SYMBOLS; i++ ) {
+    int depth = 0;
+    if ( weights[ i ] > 0 ) {
+      for ( int j = i; parent[ j ] >= 0; j = parent[ j ] ) {
+        depth++;
+      }
+
+      // A lone symbol still needs a bit to be written with
+      if ( depth == 0 ) {
+        depth = 1;
+      }
+    }
+
+    lengths[ i ] = depth > HUFF_MAX_LEN ? HUFF_MAX_LEN + 1 : depth;
+    if ( depth > longest ) {
+      longest = depth;
+    }
+  }
+
+  return longest;
+}
+
+/* Gives each symbol its canonical code, from the code lengths. Shorter codes
+   come first, and codes of the same length go in symbol order, so the
+   lengths are all inflate needs to rebuild the codes.
+
+   @param h is the Huffman code.
+*/
+static void assignCodes( HuffCode *h )
+{
+  int count[ HUFF_MAX_LEN + 1 ] = { 0 };
+  for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+    count[ h->lengths[ s ] ]++;
+  }
+  count[ 0 ] = 0;
+
+  unsigned int next[ HUFF_MAX_LEN + 1 ];
+  unsigned int code = 0;
+  for ( int len = 1; len <= HUFF_MAX_LEN; len++ ) {
+    code = ( code + count[ len - 1 ] ) << 1;
+    next[ len ] = code;
+  }
+
+  for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+    if ( h->lengths[ s ] ) {
+      h->bits[ s ] = next[ h->lengths[ s ] ]++;
+    }
+  }
+}
+
+bool planCode( HuffCode *h )
+{
+  long freq[ HUFF_SYMBOLS ] = { 0 };
+  for ( long i = 0; i < h->count; i++ ) {
+    freq[ symbolOf( h->codes[ i ] ) ]++;
+  }
+  freq[ HUFF_END ] = 1;
+
+  // Evening out the counts shortens the longest code, until it fits
+  long weights[ HUFF_SYMBOLS ];
+  memcpy( weights, freq, sizeof( weights ) );
+  while ( huffmanLengths( weights, h->lengths ) > HUFF_MAX_LEN ) {
+    for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+      weights[ s ] = ( weights[ s ] + 1 ) / 2;
+    }
+  }
+  assignCodes( h );
+
+  // Each stream is padded out to a whole byte
+  long huffBits = ( HUFF_HEADER_BYTES + HUFF_STREAMS ) * BBITS;
+  for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+    huffBits += freq[ s ] * ( h->lengths[ s ] + h->extra[ s ] );
+  }
+
+  h->plain = huffBits >= h->plainBits;
+  return !h->plain;
+}
+
+/* Writes one LZW code in the Huffman code.
+
+   @param w is the bit writer receiving the code.
+   @param h is the Huffman code.
+   @param code is the LZW code.
+*/
+static void writeSymbol( BitWriter *w, HuffCode const *h, unsigned int code )
+{
+  int s = symbolOf( code );
+  int len = h->lengths[ s ], extra = h->extra[ s ];
+
+  // Most codes and their low bits fit in one write
+  if ( len + extra <= WRITE_BITS ) {
+    writeCode( w, ( h->bits[ s ] << extra ) | ( code - h->base[ s ] ), len + extra );
+  } else {
+    writeCode( w, h->bits[ s ], len );
+    writeCode( w, code - h->base[ s ], extra );
+  }
+}
+
+void encodeCodes( HuffCode *h )
+{
+  BitWriter w[ HUFF_STREAMS ];
+  for ( int k = 0; k < HUFF_STREAMS; k++ ) {
+    if ( !h->streams[ k ] ) {
+      h->streams[ k ] = makeBuffer();
+    }
+    h->streams[ k ]->len = 0;
+    initWriter( &w[ k ], h->streams[ k ] );
+  }
+
+  for ( long i = 0; i < h->count; i++ ) {
+    writeSymbol( &w[ i % HUFF_STREAMS ], h, h->codes[ i ] );
+  }
+
+  // The end symbol goes where the next code would have
+  writeCode( &w[ h->count % HUFF_STREAMS ], h->bits[ HUFF_END ], h->lengths[ HUFF_END ] );
+
+  for ( int k = 0; k < HUFF_STREAMS; k++ ) {
+    flushWriter( &w[ k ] );
+    if ( k < HUFF_STREAMS - 1 ) {
+      h->sizes[ k ] = h->streams[ k ]->len;
+    }
+  }
+  h->count = 0;
+  h->plainBits = 0;
+}
+
+void appendStreams( Buffer *buffer, HuffCode const *h )
+{
+  for ( int k = 0; k < HUFF_STREAMS; k++ ) {
+    reserveBuffer( buffer, h->streams[ k ]->len );
+    memcpy( buffer->data + buffer->len, h->streams[ k ]->data, h->streams[ k ]->len );
+    buffer->len += h->streams[ k ]->len;
+  }
+}
+
+void writePlain( BitWriter *w, HuffCode *h )
+{
+  for ( long i = 0; i < h->count; i++ ) {
+    writeCode( w, h->codes[ i ], h->widths[ i ] );
+  }
+  h->count = 0;
+  h->plainBits = 0;
+}
+
+bool validLengths( unsigned char const *lengths )
+{
+  long space = 0;
+  for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+    if ( lengths[ s ] > HUFF_MAX_LEN ) {
+      return false;
+    }
+    if ( lengths[ s ] ) {
+      space += 1L << ( HUFF_MAX_LEN - lengths[ s ] );
+    }
+  }
+
+  return space <= ( 1L << HUFF_MAX_LEN ) && lengths[ HUFF_END ] > 0;
+}
+
+bool startDecoding( HuffCode *h, char const *data, long len )
+{
+  assignCodes( h );
+
+  // The end symbol's code and bits no code starts with are left as length
+  // 0, so decoding stops at either
+  memset( h->table, 0, sizeof( h->table ) );
+  for ( int s = 0; s < HUFF_END; s++ ) {
+    int len = h->lengths[ s ];
+    if ( len ) {
+      int first = h->bits[ s ] << ( HUFF_MAX_LEN - len );
+      int span = 1 << ( HUFF_MAX_LEN - len );
+      for ( int i = 0; i < span; i++ ) {
+        h->table[ first + i ] = s << SYMBOL_SHIFT | h->extra[ s ] << LEN_BITS | len;
+      }
+    }
+  }
+
+  // Each stream starts where the one before it ends
+  long start = 0;
+  for ( int k = 0; k < HUFF_STREAMS; k++ ) {
+    h->pos[ k ] = start * BBITS;
+    if ( k < HUFF_STREAMS - 1 ) {
+      start += h->sizes[ k ];
+    }
+  }
+
+  h->data = ( unsigned char const * ) data;
+  h->len = len;
+  h->next = 0;
+  h->ended = false;
+  return start <= len;
+}
+
+/* Decodes one code from the bits it starts with.
+
+   @param h is the Huffman code.
+   @param w is the next 64 bits of the stream, high-order bit first.
+   @param bitPos is the position of the code in the stream, moved past it.
+   @param code is where the LZW code is stored.
+   @return true if an LZW code was decoded, or false for the end symbol or
+           bits no code starts with.
+*/
+static inline bool decodeWord( HuffCode const *h, unsigned long long w, long *bitPos,
+                               unsigned int *code )
+{
+  unsigned int entry = h->table[ w >> ( 64 - HUFF_MAX_LEN ) ];
+  int len = entry & LEN_MASK;
+  int extra = ( entry >> LEN_BITS ) & EXTRA_MASK;
+  int s = entry >> SYMBOL_SHIFT;
+
+  if ( len == 0 ) {
+    return false;
+  }
+
+  // Shifted in two steps, so a code with no extra bits adds nothing
+  *code = h->base[ s ] + ( unsigned int ) ( ( w << len ) >> 1 >> ( 63 - extra ) );
+  *bitPos += len + extra;
+  return true;
+}
+
+/* Decodes the next code from the stream whose turn it is, taking bits past
+   the end of the input as zeros.
+
+   @param h is the Huffman code being decoded with.
+   @param code is where the LZW code is stored.
+   @return true if an LZW code was decoded. Otherwise, returns false and
+           the decoding has ended.
+*/
+static bool decodeNext( HuffCode *h, unsigned int *code )
+{
+  long *bitPos = &h->pos[ h->next ];
+  long byte = *bitPos >> 3;
+  unsigned char word[ LOAD_BYTES ] = { 0 };
+  if ( byte < h->len ) {
+    memcpy( word, h->data + byte, h->len - byte < LOAD_BYTES ? h->len - byte : LOAD_BYTES );
+  }
+
+  if ( !decodeWord( h, loadWord( word ) << ( *bitPos & 7 ), bitPos, code ) ||
+       *bitPos > h->len * BBITS ) {
+    h->ended = true;
+    return false;
+  }
+
+  h->next = ( h->next + 1 ) % HUFF_STREAMS;
+  return true;
+}
+
+int decodeCodes( HuffCode *h, unsigned int *codes, int max )
+{
+  unsigned char const *data = h->data;
+  int n = 0;
+
+  // Up to the first stream's turn
+  while ( n < max && h->next != 0 && !h->ended && decodeNext( h, &codes[ n ] ) ) {
+    n++;
+  }
+
+  // A code from each stream at a time, while every stream has a whole word
+  // of input left. The streams don't wait on each other, so with the loop
+  // unrolled and the positions in registers, their codes are decoded side
+  // by side.
+  long limit = ( h->len - LOAD_BYTES ) * BBITS;
+  long p[ HUFF_STREAMS ];
+  memcpy( p, h->pos, sizeof( p ) );
+  while ( n + HUFF_STREAMS <= max && !h->ended ) {
+    bool room = true;
+    for ( int k = 0; k < HUFF_STREAMS; k++ ) {
+      room = room && p[ k ] <= limit;
+    }
+    if ( !room ) {
+      break;
+    }
+
+  // Once per stream
+#pragma GCC unroll 4
+    for ( int k = 0; k < HUFF_STREAMS; k++ ) {
+      unsigned long long w = loadWord( data + ( p[ k ] >> 3 ) ) << ( p[ k ] & 7 );
+      if ( !decodeWord( h, w, &p[ k ], &codes[ n ] ) ) {
+        h->ended = true;
+        break;
+      }
+      n++;
+    }
+  }
+  memcpy( h->pos, p, sizeof( p ) );
+
+  // The last few codes, near the end of the input
+  while ( n < max && !h->ended && decodeNext( h, &codes[ n ] ) ) {
+    n++;
+  }
+
+  return n;
+}
@@ -0,0 +1,170 @@
+/**
+   @file huffman.h
+   @author Stephen Gonsalves (dkgonsal)
+
+   The huffman file entropy codes a stream of LZW codes with a static Huffman
+   code. Codes below 256 are symbols of their own. Larger codes are grouped
+   by their highest few bits, like the distance codes of DEFLATE, and the
+   rest of their bits follow the symbol as they are. One more symbol ends
+   the stream. The code lengths go in the header, and inflate decodes
+   symbols with a single table lookup each. The codes are dealt out in turn
+   to a few streams written one after another, so inflate can decode one
+   code from each at once instead of waiting on the length of every code
+   before starting the next. LZW codes are often close to evenly spread, so
+   when the Huffman code and its table wouldn't be smaller, the codes are
+   written at their own widths instead.
+*/
+
+#ifndef _HUFFMAN_H_
+#define _HUFFMAN_H_
+
+#include "buffer.h"
+
+/** Number of codes that are symbols of their own */
+#define HUFF_LITERALS 256
+/** Number of high bits after the leading one that pick a larger code's group */
+#define HUFF_GROUP_BITS 2
+/** Number of groups for each width of larger code, widths 9 through 32 */
+#define HUFF_GROUPS ( 24 << HUFF_GROUP_BITS )
+/** Number of symbols, including the end symbol */
+#define HUFF_SYMBOLS ( HUFF_LITERALS + HUFF_GROUPS + 1 )
+/** Symbol that ends the stream */
+#define HUFF_END ( HUFF_SYMBOLS - 1 )
+/** Longest Huffman code, which sets the size of the decoding table */
+#define HUFF_MAX_LEN 12
+/** Number of bytes the code lengths take in a header, two to a byte */
+#define HUFF_TABLE_BYTES ( ( HUFF_SYMBOLS + 1 ) / 2 )
+/** Number of streams the codes are dealt out to */
+#define HUFF_STREAMS 4
+/** Number of bytes for the size of each stream but the last in a header */
+#define HUFF_SIZE_BYTES 4
+/** Number of bytes the Huffman code takes in a header */
+#define HUFF_HEADER_BYTES ( HUFF_TABLE_BYTES + ( HUFF_STREAMS - 1 ) * HUFF_SIZE_BYTES )
+
+/** A static Huffman code, with the LZW codes waiting to be written in it. */
+typedef struct {
+  /** Number of bits in each symbol's Huffman code, 0 if it isn't used. */
+  unsigned char lengths[ HUFF_SYMBOLS ];
+  /** Huffman code of each symbol. */
+  unsigned int bits[ HUFF_SYMBOLS ];
+  /** Smallest LZW code in each symbol's group. */
+  unsigned int base[ HUFF_SYMBOLS ];
+  /** Number of LZW code bits that follow each symbol. */
+  unsigned char extra[ HUFF_SYMBOLS ];
+  /** Symbol, number of LZW code bits after it and code length for every
+      HUFF_MAX_LEN bits a code could start with, so one lookup gives the
+      whole length of a code. */
+  unsigned int table[ 1 << HUFF_MAX_LEN ];
+  /** Number of bytes in each stream but the last. */
+  long sizes[ HUFF_STREAMS - 1 ];
+  /** Streams the codes are written to, made the first time they're used. */
+  Buffer *streams[ HUFF_STREAMS ];
+  /** Streams being decoded, one after another. */
+  unsigned char const *data;
+  /** Number of bytes in data. */
+  long len;
+  /** Bit each stream's next code starts at. */
+  long pos[ HUFF_STREAMS ];
+  /** Stream the next code comes from. */
+  int next;
+  /** True once the end symbol or the end of the input has been read. */
+  bool ended;
+  /** True if planCode() found the codes take fewer bits at their own widths. */
+  bool plain;
+  /** LZW codes waiting to be written. */
+  unsigned int *codes;
+  /** Width each waiting code would be written at without the Huffman code. */
+  unsigned char *widths;
+  /** Total of the widths of the waiting codes. */
+  long plainBits;
+  /** Number of codes waiting. */
+  long count;
+  /** Number of codes there's room for. */
+  long cap;
+} HuffCode;
+
+/* Makes an empty Huffman code.
+
+   @return the new code.
+*/
+HuffCode *makeHuffCode();
+
+/* Frees a Huffman code and the codes waiting in it.
+
+   @param h is the code being freed.
+*/
+void freeHuffCode( HuffCode *h );
+
+/* Adds an LZW code to the ones waiting to be written.
+
+   @param h is the Huffman code collecting them.
+   @param code is the LZW code.
+   @param width is the number of bits the code would take without the
+          Huffman code.
+*/
+void collectCode( HuffCode *h, unsigned int code, int width );
+
+/* Builds the Huffman code that best fits the waiting LZW codes, with no
+   code longer than HUFF_MAX_LEN bits, and decides whether it's worth using.
+
+   @param h is the Huffman code being built.
+   @return true if the codes, end symbol and table take fewer bits than the
+           codes at their own widths. Otherwise, returns false and plain is
+           set.
+*/
+bool planCode( HuffCode *h );
+
+/* Writes the waiting LZW codes in the Huffman code built by planCode(),
+   dealing them out to the streams and ending them with the end symbol.
+   Sets the stream sizes and empties the list of waiting codes.
+
+   @param h is the Huffman code.
+*/
+void encodeCodes( HuffCode *h );
+
+/* Appends the streams filled by encodeCodes() to a buffer.
+
+   @param buffer is the buffer the streams are appended to.
+   @param h is the Huffman code holding the streams.
+*/
+void appendStreams( Buffer *buffer, HuffCode const *h );
+
+/* Writes the waiting LZW codes at their own widths, for when planCode()
+   found that smaller, and empties the list of waiting codes.
+
+   @param w is the bit writer receiving the codes.
+   @param h is the Huffman code holding the codes.
+*/
+void writePlain( BitWriter *w, HuffCode *h );
+
+/* Checks that code lengths read from a header make a Huffman code that could
+   have been written.
+
+   @param lengths is the length of each symbol's code.
+   @return true if no length is over HUFF_MAX_LEN, the lengths don't claim
+           more codes than there are and the end symbol has a code.
+*/
+bool validLengths( unsigned char const *lengths );
+
+/* Gets ready to decode streams with the code lengths and stream sizes
+   already in h, from a header. The lengths have to have passed
+   validLengths().
+
+   @param h is the Huffman code being decoded with.
+   @param data is the streams, one after another.
+   @param len is the number of bytes in data.
+   @return true if the streams fit in data. Otherwise, returns false.
+*/
+bool startDecoding( HuffCode *h, char const *data, long len );
+
+/* Decodes a batch of LZW codes, taking them from the streams in turn.
+
+   @param h is the Huffman code, made ready by startDecoding().
+   @param codes is where the LZW codes are stored.
+   @param max is the most codes to read.
+   @return the number of codes read, less than max only once the end symbol
+           or the end of the input is reached.
+*/
+int decodeCodes( HuffCode *h, unsigned int *codes, int max );
+
+#endif
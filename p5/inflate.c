@@ -6,8 +6,11 @@
    for the user.
 */
 
-#include "dictionary.h"
-#include "buffer.h"
+#include "lzw.h"
+#include "block.h"
+#include "batch.h"
+#include "stats.h"
+#include <limits.h>
 
 
 /** Minimum number of bits in an entry */
@@ -17,74 +20,275 @@
 /** Minimum number of command line arguments */
 #define MIN_ARGS 3
 /** Maximum number of command line arguments */
-#define MAX_ARGS 6
+#define MAX_ARGS 14
 /** Indexes for file arguments */
 #define FILE_ARGS 2
+/** Usage message for the options inflate takes */
+#define USAGE \
+  "usage: inflate [-d] [-v] [-H] [-s] [-b bits|auto] [-j threads]\n" \
+  "               [--stream] [--range start:len] [-D dictfile]\n" \
+  "               [--max-dict-mem bytes]\n" \
+  "               (infile outfile | --batch manifest)\n" \
+  "-s times reading, coding and writing; coding includes bit packing\n"
 
-/* The LZW decompression algorithm implemented as a helper function.
+/* Decompresses one block of a container with a fresh dictionary. Run on a
+   worker thread by runBlocks().
 
-   @param d the dictionary being used for word searching.
-   @param b the buffer being used for decompression.
-   @param bits number of bits indicated by argument.
-   @return the buffer to the main function.
+   @param data the block's compressed bytes.
+   @param len number of bytes in the block.
+   @param bits number of bits in each code of the block.
+   @return the decompressed block.
 */
-Buffer *inflate( Dictionary *d, Buffer *inBuffer, int bits )
+static Buffer *inflateBlock( char *data, int len, int bits )
 {
-  Buffer *outBuffer = makeBuffer();
-  unsigned int loc = 0;
+  LZW *z = lzwMake( bits, false, false );
 
-  for ( int i = 0; i < inBuffer->len; i++ ) {      
-    if ( ( loc + bits ) > ( inBuffer->len * BBITS ) ) {
-      break;
-    }
-    
-    unsigned int dictIndex = 0, secondLoc = 0, nextWord = 0;
+  Buffer *outBuffer = lzwInflate( z, data, len, UNKNOWN_LEN );
+  if ( !outBuffer ) {
+    INFLATE_ERROR( z->badCode );
+  }
 
-    for ( int j = 0; j < bits; j++ ) {
-      if ( getBit( inBuffer, loc ) ) {
-        dictIndex = dictIndex | ( 0x01 << ( bits - 1 - j ) );
-      }
-      loc++;
-    }
+  lzwFree( z );
+  return outBuffer;
+}
 
-    char *currentWord = d->wordList[ dictIndex ];
-    
-    for ( int k = 0; k < d->wordLen[ dictIndex ]; k++ ) {
-      appendByte( outBuffer, currentWord[ k ] );
-    }
+/* Decompresses a block container, decompressing the blocks in parallel on
+   the given number of threads. The code width comes from the container.
 
-    if ( i < inBuffer->len - 1 ) {
-      secondLoc = loc;
-      
-      if ( ( secondLoc + bits ) > ( inBuffer->len * BBITS ) ) {
-        break;
-      }
-      
+   @param inBuffer the container being decompressed.
+   @param outFile name of the file the output is written to.
+   @param threads number of worker threads.
+*/
+void inflateBlocks( Buffer *inBuffer, char const *outFile, int threads )
+{
+  int bits, count;
+  Block *blocks = readContainer( inBuffer, &bits, &count );
 
-      for ( int k = 0; k < bits; k++ ) {   
-        if ( getBit( inBuffer, secondLoc ) ) {
-          nextWord = nextWord | ( 0x01 << ( bits - 1 - k ));
-        }
-        secondLoc++;
-      }
-      
-      // Check for invalid compression in file
-      INFLATE_ERROR( nextWord, d );
-
-      char *newWord = d->wordList[ nextWord ];
-      int len = d->wordLen[ dictIndex ];
-      char *word = ( char * ) malloc( sizeof( char ) * len + 1 );
-
-      memcpy( word, d->wordList[ dictIndex ], len );
-      word[ len ] = newWord[ 0 ];
-      addWord( d, word, d->wordLen[ dictIndex ] + 1);
-      free( word );
+  if ( bits < MIN_BITS || bits > MAX_BITS ) {
+    BLOCK_ERROR( "Invalid block container" );
+  }
+
+  runBlocks( blocks, count, threads, inflateBlock );
+
+  Buffer *outBuffer = joinBlocks( blocks, count );
+  freeBlocks( blocks, count );
+
+  saveBuffer( outBuffer, outFile );
+  freeBuffer( outBuffer );
+}
+
+/* Decompresses part of a block container, reading and decoding only the
+   blocks that hold some of the range, so the time taken depends on the size
+   of the range rather than the size of the file. A range running past the
+   end of the data stops at the end.
+
+   @param inFile name of the container being read.
+   @param outFile name of the file the range is written to.
+   @param start offset of the first uncompressed byte of the range.
+   @param len number of bytes in the range.
+   @param threads number of worker threads.
+*/
+void inflateRange( char const *inFile, char const *outFile, long start, long len, int threads )
+{
+  FILE *in = openStream( inFile, "rb" );
+  int bits, count;
+  Block *blocks = readIndex( in, &bits, &count );
+
+  if ( bits < MIN_BITS || bits > MAX_BITS ) {
+    BLOCK_ERROR( "Invalid block container" );
+  }
+
+  // Skip the blocks that end before the range starts
+  int first = 0;
+  long rawPos = 0, dataPos = 0;
+  while ( first < count && rawPos + blocks[ first ].rawLen <= start ) {
+    rawPos += blocks[ first ].rawLen;
+    dataPos += blocks[ first ].len;
+    first++;
+  }
+
+  // Then take blocks until one reaches the end of the range
+  int last = first;
+  long rawEnd = rawPos, dataLen = 0;
+  while ( last < count && rawEnd < start + len ) {
+    rawEnd += blocks[ last ].rawLen;
+    dataLen += blocks[ last ].len;
+    last++;
+  }
+
+  // The blocks in a range sit next to each other in the file
+  Buffer *data = makeBuffer();
+  reserveBuffer( data, dataLen );
+  if ( !skipStream( in, dataPos ) ||
+       ( long ) fread( data->data, 1, dataLen, in ) != dataLen ) {
+    BLOCK_ERROR( "Invalid block container" );
+  }
+  closeStream( in );
+
+  long pos = 0;
+  for ( int i = first; i < last; i++ ) {
+    blocks[ i ].data = data->data + pos;
+    pos += blocks[ i ].len;
+  }
+
+  runBlocks( blocks + first, last - first, threads, inflateBlock );
+
+  FILE *out = openStream( outFile, "wb" );
+  long skip = start - rawPos;
+  long remaining = len;
+
+  for ( int i = first; i < last; i++ ) {
+    if ( blocks[ i ].result->len != blocks[ i ].rawLen ) {
+      BLOCK_ERROR( "Invalid block container" );
     }
+
+    long n = blocks[ i ].rawLen - skip < remaining ? blocks[ i ].rawLen - skip : remaining;
+    fwrite( blocks[ i ].result->data + skip, 1, n, out );
+    remaining -= n;
+    skip = 0;
   }
 
-  return outBuffer;
+  closeStream( out );
+  freeBlocks( blocks, count );
+  freeBuffer( data );
+}
+
+/* Works out how the codes at the start of a compressed file were written.
+   A header is used if one is required or if the code width wasn't given on
+   the command line. Otherwise the codes are taken to start right away, with
+   the width and flags from the command line.
+
+   @param inBuffer the buffer holding the start of the compressed file.
+   @param fileLen number of bytes in the whole file, or UNKNOWN_LEN.
+   @param needHeader true if the file has to start with a header.
+   @param bitsGiven true if the code width was given on the command line.
+   @param z the context, whose code width, flags, entry limit and Huffman
+          code are replaced with the ones in the header.
+   @param rawLen where the decompressed length is stored, or UNKNOWN_LEN.
+   @return the number of bytes at the start of the buffer that aren't codes.
+*/
+static int readFormat( Buffer *inBuffer, long fileLen, bool needHeader, bool bitsGiven,
+                       LZW *z, long *rawLen )
+{
+  *rawLen = UNKNOWN_LEN;
+  z->huffmanInput = false;
+
+  if ( !needHeader && ( bitsGiven || !hasHeader( inBuffer->data, inBuffer->len ) ) ) {
+    return 0;
+  }
+
+  if ( inBuffer->len < HEADER_LEN || inBuffer->len < headerLength( inBuffer->data ) ) {
+    HEADER_ERROR();
+  }
+
+  Header h;
+  if ( !readHeader( inBuffer->data, fileLen, z->longestWord, &h ) ) {
+    HEADER_ERROR();
+  }
+  z->bits = h.bits;
+  z->variable = h.flags & FLAG_VARIABLE;
+  z->maxEntries = h.entries;
+  if ( h.flags & FLAG_HUFFMAN ) {
+    lzwUseCodeTable( z, &h );
+  }
+  *rawLen = h.length;
+  return headerLength( inBuffer->data );
 }
 
+/* Checks whether a compressed file is a block container.
+
+   @param inBuffer the buffer holding the start of the compressed file.
+   @return true if it starts with the container's magic number.
+*/
+static bool isContainer( Buffer *inBuffer )
+{
+  return inBuffer->len >= BLOCK_MAGIC_LEN &&
+         memcmp( inBuffer->data, BLOCK_MAGIC, BLOCK_MAGIC_LEN ) == 0;
+}
+
+/** How each file of a --batch run is decompressed. */
+typedef struct {
+  /** True if every file has to start with a header. */
+  bool needHeader;
+  /** True if the code width was given on the command line. */
+  bool bitsGiven;
+  /** Number of bits in each code, or the largest width when widths vary. */
+  int bits;
+  /** True if code widths grow with the dictionary. */
+  bool variable;
+  /** Name of the trained dictionary every file starts from, or NULL. */
+  char const *dictFile;
+  /** Most bytes each dictionary may use, or 0 for no limit. */
+  long memArg;
+} BatchOptions;
+
+/* Makes the context one batch worker decompresses all its files with.
+
+   @param arg is the BatchOptions for the run.
+   @return the new context.
+*/
+static LZW *makeBatchContext( void *arg )
+{
+  BatchOptions *o = ( BatchOptions * ) arg;
+
+  LZW *z = lzwMake( o->bits, o->variable, false );
+  if ( o->dictFile && !lzwUseDictionary( z, o->dictFile ) ) {
+    DICTIONARY_ERROR( o->dictFile );
+  }
+  if ( o->memArg && !lzwLimitMemory( z, o->memArg ) ) {
+    USAGE_ERROR( USAGE );
+  }
+  return z;
+}
+
+/* Decompresses one file of a batch, reusing the worker's context. Block
+   containers are recognized the same way as for a single file.
+
+   @param z the worker's context.
+   @param inFile name of the file being decompressed.
+   @param outFile name of the file the output is written to.
+   @param arg is the BatchOptions for the run.
+*/
+static void inflateBatchFile( LZW *z, char const *inFile, char const *outFile, void *arg )
+{
+  BatchOptions *o = ( BatchOptions * ) arg;
+  Buffer *inBuffer = loadBuffer( inFile );
+
+  if ( !o->bitsGiven && !o->needHeader && isContainer( inBuffer ) ) {
+    inflateBlocks( inBuffer, outFile, 1 );
+    freeBuffer( inBuffer );
+    return;
+  }
+
+  // A header only describes its own file, so the context's format is put
+  // back for the next one
+  int bits = z->bits;
+  bool variable = z->variable;
+  long entries = z->maxEntries;
+
+  long rawLen;
+  int skip = readFormat( inBuffer, inBuffer->len, o->needHeader, o->bitsGiven, z, &rawLen );
+  if ( o->dictFile && skip && ( z->bits != bits || z->variable != variable || z->maxEntries ) ) {
+    DICTIONARY_ERROR( o->dictFile );
+  }
+
+  Buffer *outBuffer = lzwInflate( z, inBuffer->data + skip, inBuffer->len - skip, rawLen );
+  if ( !outBuffer ) {
+    INFLATE_ERROR( z->badCode );
+  }
+  freeBuffer( inBuffer );
+
+  if ( rawLen != UNKNOWN_LEN && outBuffer->len != rawLen ) {
+    HEADER_ERROR();
+  }
+
+  saveBuffer( outBuffer, outFile );
+  freeBuffer( outBuffer );
+
+  z->bits = bits;
+  z->variable = variable;
+  z->maxEntries = entries;
+}
 
 /* This is the starting point of the deflate program. Using the linked buffer/dictionary
    headers, deflate will read from a valid input file and create a buffer to write
@@ -97,47 +301,233 @@ Buffer *inflate( Dictionary *d, Buffer *inBuffer, int bits )
 int main( int argc, char *argv[] )
 { 
   bool printDict = false;
+  bool stream = false;
+  bool variable = false;
+  bool needHeader = false;
+  bool bitsGiven = false;
   int bitArg = DEFAULT_BITS;
-  Dictionary *d;
+  int threads = 0;
+  bool range = false;
+  char const *dictFile = NULL;
+  long rangeStart = 0, rangeLen = 0;
+  long memArg = 0;
+  bool stats = false;
 
   if ( argc < MIN_ARGS || argc > MAX_ARGS ) {
-    USAGE_ERROR( "inflate" );
+    USAGE_ERROR( USAGE );
   }
 
-  int inFile = argc - FILE_ARGS;
+  // A batch takes its files from the manifest instead
+  char const *manifest = findManifest( argc, argv );
+  int inFile = manifest ? argc : argc - FILE_ARGS;
   int outFile = argc - 1;
   
   for ( int i = 1; i < inFile; i++ ) {
    if ( strcmp( "-b", argv[ i ] ) == 0 ) {
-      if ( sscanf( argv[ i + 1 ], "%d", &bitArg ) == 1 && 
+      // The width deflate picked for -b auto is in the header
+      if ( i + 1 < inFile && strcmp( "auto", argv[ i + 1 ] ) == 0 ) {
+        needHeader = true;
+        i++;
+        continue;
+      } else if ( sscanf( argv[ i + 1 ], "%d", &bitArg ) == 1 && 
            bitArg > MIN_BITS - 1 && bitArg < MAX_BITS + 1 ) {
+        bitsGiven = true;
         i++;
         continue;
       } else {
-        USAGE_ERROR( "inflate" );
+        USAGE_ERROR( USAGE );
       }   
     } else if ( strcmp( "-d", argv[ i ] ) == 0 ) {
       printDict = true;
       continue;
+    } else if ( strcmp( "-j", argv[ i ] ) == 0 ) {
+      if ( i + 1 < inFile && sscanf( argv[ i + 1 ], "%d", &threads ) == 1 &&
+           threads > 0 && threads <= MAX_THREADS ) {
+        i++;
+        continue;
+      } else {
+        USAGE_ERROR( USAGE );
+      }
+    } else if ( strcmp( "-H", argv[ i ] ) == 0 ) {
+      needHeader = true;
+      continue;
+    } else if ( strcmp( "-v", argv[ i ] ) == 0 ) {
+      variable = true;
+      continue;
+    } else if ( strcmp( "-s", argv[ i ] ) == 0 ) {
+      stats = true;
+      continue;
+    } else if ( strcmp( "--stream", argv[ i ] ) == 0 ) {
+      stream = true;
+      continue;
+    } else if ( strcmp( "--range", argv[ i ] ) == 0 ) {
+      int used = 0;
+      if ( i + 1 < inFile &&
+           sscanf( argv[ i + 1 ], "%ld:%ld%n", &rangeStart, &rangeLen, &used ) == 2 &&
+           argv[ i + 1 ][ used ] == '\0' && rangeStart >= 0 && rangeLen >= 0 ) {
+        range = true;
+        i++;
+        continue;
+      } else {
+        USAGE_ERROR( USAGE );
+      }
+    } else if ( strcmp( "-D", argv[ i ] ) == 0 && i + 1 < inFile ) {
+      dictFile = argv[ ++i ];
+      continue;
+    } else if ( strcmp( "--max-dict-mem", argv[ i ] ) == 0 ) {
+      if ( i + 1 < inFile && sscanf( argv[ i + 1 ], "%ld", &memArg ) == 1 && memArg > 0 ) {
+        i++;
+        continue;
+      } else {
+        USAGE_ERROR( USAGE );
+      }
+    } else if ( strcmp( "--batch", argv[ i ] ) == 0 && i + 1 < inFile ) {
+      i++;
+      continue;
     } else {
-        USAGE_ERROR( "inflate" );
+        USAGE_ERROR( USAGE );
     }
   }
 
-  d = makeDictionary( bitArg );
-  Buffer *inBuffer = loadBuffer( argv[ inFile ] );
-  Buffer *outBuffer = makeBuffer();
+  // Each file of a batch is decompressed whole, with -j files at a time
+  if ( manifest && ( stream || printDict || range || stats ) ) {
+    USAGE_ERROR( USAGE );
+  }
+  bool blocks = threads && !manifest;
 
-  outBuffer = inflate( d, inBuffer, bitArg );
-  freeBuffer( inBuffer );
+  // A trained dictionary brings its own width, and blocks start out empty
+  if ( dictFile && ( bitsGiven || variable || blocks || range ) ) {
+    USAGE_ERROR( USAGE );
+  }
 
-  saveBuffer( outBuffer, argv[ outFile ] );
-  freeBuffer( outBuffer );
+  // Blocks and trained dictionaries never evict words
+  if ( memArg && ( dictFile || blocks || range ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  // Blocks each get their own dictionary and are read and written whole
+  if ( blocks && ( stream || printDict || variable || needHeader ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  // Variable width codes need room for the clear code after the single bytes
+  if ( variable && bitArg < VAR_MIN_BITS ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  if ( manifest ) {
+    BatchOptions o = { needHeader, bitsGiven, bitArg, variable, dictFile, memArg };
+    runBatch( manifest, threads ? threads : 1, makeBatchContext, inflateBatchFile, &o );
+    return ( EXIT_SUCCESS );
+  }
+
+  // Runs that use more than one context only have their time reported
+  Stats s;
+  startStats( &s );
+
+  // Only a block container has places to start decoding from
+  if ( range ) {
+    if ( stream || printDict || variable || needHeader || bitsGiven ) {
+      USAGE_ERROR( USAGE );
+    }
+
+    // Keep the end of the range from overflowing
+    if ( rangeLen > LONG_MAX - rangeStart ) {
+      rangeLen = LONG_MAX - rangeStart;
+    }
+    inflateRange( argv[ inFile ], argv[ outFile ], rangeStart, rangeLen, threads ? threads : 1 );
+    endPhase( &s, PHASE_CODE );
+    if ( stats ) {
+      printStats( &s, NULL );
+    }
+    return ( EXIT_SUCCESS );
+  }
+
+  FILE *in = NULL;
+  Buffer *inBuffer;
+  long fileLen;
+
+  if ( stream ) {
+    in = openStream( argv[ inFile ], "rb" );
+    fileLen = streamLength( in );
+    inBuffer = makeBuffer();
+    readChunk( inBuffer, in );
+  } else {
+    inBuffer = loadBuffer( argv[ inFile ] );
+    fileLen = inBuffer->len;
+    endPhase( &s, PHASE_READ );
+  }
+
+  // A block container says so itself, unless we were told the code width
+  bool container = !bitsGiven && isContainer( inBuffer );
+  if ( threads || ( container && !stream && !needHeader ) ) {
+    inflateBlocks( inBuffer, argv[ outFile ], threads ? threads : 1 );
+    freeBuffer( inBuffer );
+    endPhase( &s, PHASE_CODE );
+    if ( stats ) {
+      printStats( &s, NULL );
+    }
+    return ( EXIT_SUCCESS );
+  }
+
+  long rawLen;
+  LZW *z = lzwMake( bitArg, variable, false );
+  if ( memArg && !lzwLimitMemory( z, memArg ) ) {
+    USAGE_ERROR( USAGE );
+  }
+
+  // The dictionary goes in first, since its words bound what the header
+  // can claim
+  if ( dictFile && !lzwUseDictionary( z, dictFile ) ) {
+    DICTIONARY_ERROR( dictFile );
+  }
+  bitArg = z->bits;
+  variable = z->variable;
+
+  // A header has to agree with the dictionary the codes were written with
+  int skip = readFormat( inBuffer, fileLen, needHeader, bitsGiven, z, &rawLen );
+  if ( dictFile && skip && ( bitArg != z->bits || variable != z->variable || z->maxEntries ) ) {
+    DICTIONARY_ERROR( dictFile );
+  }
+
+  if ( stream ) {
+    FILE *out = openStream( argv[ outFile ], "wb" );
+
+    // Reading and writing are mixed in with decompressing
+    if ( !lzwInflateStream( z, in, inBuffer, skip, out ) ) {
+      INFLATE_ERROR( z->badCode );
+    }
+    s.packedBytes = streamBytes( in );
+    closeStream( in );
+    closeStream( out );
+    endPhase( &s, PHASE_CODE );
+  } else {
+    Buffer *outBuffer = lzwInflate( z, inBuffer->data + skip, inBuffer->len - skip, rawLen );
+    if ( !outBuffer ) {
+      INFLATE_ERROR( z->badCode );
+    }
+    endPhase( &s, PHASE_CODE );
+    s.packedBytes = inBuffer->len;
+
+    // The header said how long the output should be
+    if ( rawLen != UNKNOWN_LEN && outBuffer->len != rawLen ) {
+      HEADER_ERROR();
+    }
+
+    saveBuffer( outBuffer, argv[ outFile ] );
+    endPhase( &s, PHASE_WRITE );
+    freeBuffer( outBuffer );
+  }
+  freeBuffer( inBuffer );
   
   if ( printDict ) {
-    reportDictionary( d );
+    reportDictionary( z->d );
+  }
+
+  if ( stats ) {
+    printStats( &s, z );
   }
 
-  freeDictionary( d );
+  lzwFree( z );
   return ( EXIT_SUCCESS );
 }
\ No newline at end of file
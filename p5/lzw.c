@@ -0,0 +1,829 @@
+/**
+   @file lzw.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The lzw file is the LZW compressor and decompressor, used by the deflate
+   and inflate programs and built into the liblzw library.
+*/
+
+#include "lzw.h"
+#include "pack.h"
+#include "unpack.h"
+#include <limits.h>
+
+/** Number of input bytes between compression ratio checks */
+#define RATIO_CHECK 10000
+/** Number of fixed-width codes packed or unpacked at a time */
+#define CODE_BATCH 1024
+
+/* Gets the context's dictionary ready for a new call at the given width,
+   making a new one only if the width changed. A trained dictionary is just
+   reset, since its width and clear code were fixed when it was trained.
+
+   @param z the context.
+   @param bits number of bits in each code.
+*/
+static void useWidth( LZW *z, int bits )
+{
+  if ( z->trained ) {
+    resetDictionary( z->d );
+    return;
+  }
+
+  long size = ( long ) 1 << bits;
+  if ( z->maxEntries && z->maxEntries < size ) {
+    size = z->maxEntries;
+  }
+
+  if ( z->d->dictSize == size && z->d->evict == ( z->maxEntries != 0 ) ) {
+    // Drop the clear code too, it's added back if this call uses it
+    z->d->baseLength = MIN_DICT_SIZE;
+    resetDictionary( z->d );
+  } else {
+    freeDictionary( z->d );
+    z->d = makeDictionary( bits );
+  }
+
+  if ( z->maxEntries ) {
+    limitDictionary( z->d, z->maxEntries );
+  }
+
+  z->bits = bits;
+  if ( z->variable ) {
+    addClearCode( z->d );
+  }
+}
+
+/** State of a compression in progress, carried across chunks of input. */
+typedef struct {
+  /** Dictionary being used for word writing/searching. */
+  Dictionary *d;
+  /** Bit writer the codes are written to. */
+  BitWriter writer;
+  /** Number of bits in each code, or the largest width when widths vary. */
+  int bits;
+  /** True if code widths grow with the dictionary and clear codes are sent. */
+  bool variable;
+  /** Code of the match in progress, NO_CODE if there isn't one. */
+  int match;
+  /** Input bytes coded since the dictionary was last reset. */
+  long inCount;
+  /** Output bits written since the dictionary was last reset. */
+  long outBits;
+  /** Value of inCount at which the compression ratio is next checked. */
+  long nextCheck;
+  /** Compression ratio at the last check. */
+  double lastRatio;
+  /** Fixed-width codes waiting to be packed together. */
+  unsigned int batch[ CODE_BATCH ];
+  /** Number of codes waiting in batch. */
+  int batchLen;
+  /** Huffman code all the codes are held back for, or NULL to write them as
+      they come. */
+  HuffCode *huff;
+  /** Number of codes written. */
+  long codes;
+  /** Number of input bytes the codes written stand for. */
+  long coded;
+  /** Value of coded when the dictionary first filled, or -1 if it hasn't. */
+  long fullAt;
+} Deflater;
+
+/* Starts a compression, with the dictionary already reset by useWidth().
+
+   @param z the compression state being initialized.
+   @param d the dictionary being used for word writing/searching.
+   @param bits number of bits indicated by argument.
+   @param variable true if code widths grow with the dictionary.
+   @param huff Huffman code the codes are collected for, or NULL.
+*/
+static void initDeflater( Deflater *z, Dictionary *d, int bits, bool variable, HuffCode *huff )
+{
+  z->d = d;
+  z->bits = bits;
+  z->variable = variable;
+  z->match = NO_CODE;
+  z->inCount = 0;
+  z->outBits = 0;
+  z->nextCheck = RATIO_CHECK;
+  z->lastRatio = 0;
+  z->batchLen = 0;
+  z->huff = huff;
+  z->codes = 0;
+  z->coded = 0;
+  z->fullAt = -1;
+}
+
+/* Writes a code, at the width inflate will expect to read it with.
+
+   @param z the compression state.
+   @param code the code being written.
+*/
+static void emitCode( Deflater *z, int code )
+{
+  z->codes++;
+  z->coded += z->d->wordLen[ code ];
+
+  // Huffman coded codes are written once they've all been seen. Variable
+  // width ones still count their width, so clear codes go where they would
+  // without the Huffman code.
+  if ( z->huff ) {
+    int width = z->variable ? codeWidth( z->d->dictLength ) : z->bits;
+    collectCode( z->huff, code, width );
+    z->outBits += width;
+    return;
+  }
+
+  // Fixed-width codes are packed a batch at a time
+  if ( !z->variable ) {
+    z->batch[ z->batchLen++ ] = code;
+    if ( z->batchLen == CODE_BATCH ) {
+      writeCodes( &z->writer, z->batch, z->batchLen, z->bits );
+      z->batchLen = 0;
+    }
+    return;
+  }
+
+  int width = codeWidth( z->d->dictLength );
+
+  writeCode( &z->writer, code, width );
+  z->outBits += width;
+}
+
+/* Once the dictionary is full, checks the compression ratio since the last
+   reset every RATIO_CHECK input bytes. If it has dropped since the last check,
+   the dictionary has stopped fitting the input, so a clear code is sent and
+   it starts over.
+
+   @param z the compression state.
+*/
+static void checkRatio( Deflater *z )
+{
+  if ( !z->variable || z->d->dictLength < z->d->dictSize || z->inCount < z->nextCheck ) {
+    return;
+  }
+
+  double ratio = ( double ) z->inCount * BBITS / z->outBits;
+  if ( ratio < z->lastRatio ) {
+    emitCode( z, CLEAR_CODE );
+    resetDictionary( z->d );
+    z->inCount = 0;
+    z->outBits = 0;
+    ratio = 0;
+  }
+
+  z->lastRatio = ratio;
+  z->nextCheck = z->inCount + RATIO_CHECK;
+}
+
+/* Compresses a run of input bytes, carrying the match in progress across
+   calls so the input can arrive in chunks.
+
+   @param z the compression state.
+   @param data the bytes being compressed.
+   @param len number of bytes in data.
+*/
+static void deflateBytes( Deflater *z, char const *data, int len )
+{
+  Dictionary *d = z->d;
+  int match = z->match;
+  int i = 0;
+
+  if ( match == NO_CODE && len > 0 ) {
+    match = ( unsigned char ) data[ i++ ];
+  }
+
+  while ( i < len ) {
+    // Follow the trie for as long as the dictionary has a match
+    int nextIndex;
+    while ( i < len && ( nextIndex = findChild( d, match, data[ i ] ) ) != NO_CODE ) {
+      match = nextIndex;
+      i++;
+    }
+
+    if ( i == len ) {
+      break;
+    }
+
+    emitCode( z, match );
+    z->inCount += d->wordLen[ match ];
+
+    // The longest match plus the byte that ended it becomes a new word
+    addChild( d, match, data[ i ] );
+    if ( z->fullAt < 0 && d->dictLength == d->dictSize ) {
+      z->fullAt = z->coded;
+    }
+    checkRatio( z );
+    match = ( unsigned char ) data[ i++ ];
+  }
+
+  z->match = match;
+}
+
+/* Writes a header describing the codes that follow.
+
+   @param z the context being compressed with.
+   @param outBuffer the buffer the header is written to.
+   @param length number of bytes in the input, or UNKNOWN_LEN.
+   @param huff Huffman code the codes are written in, or NULL.
+*/
+static void emitHeader( LZW *z, Buffer *outBuffer, long length, HuffCode const *huff )
+{
+  Header h = { ( z->variable ? FLAG_VARIABLE : 0 ) | ( z->d->evict ? FLAG_EVICT : 0 ) |
+               ( huff ? FLAG_HUFFMAN : 0 ), z->bits, length, z->maxEntries };
+  if ( huff ) {
+    memcpy( h.lengths, huff->lengths, HUFF_SYMBOLS );
+    memcpy( h.sizes, huff->sizes, sizeof( h.sizes ) );
+  }
+  writeHeader( outBuffer, &h );
+}
+
+/* Writes the match still in progress and pads out the last byte.
+
+   @param z the compression state.
+*/
+static void finishDeflater( Deflater *z )
+{
+  if ( z->match != NO_CODE ) {
+    emitCode( z, z->match );
+    z->match = NO_CODE;
+  }
+
+  if ( z->huff ) {
+    writePlain( &z->writer, z->huff );
+  } else {
+    writeCodes( &z->writer, z->batch, z->batchLen, z->bits );
+  }
+  flushWriter( &z->writer );
+}
+
+/* Adds what a finished compression did to the context's counts.
+
+   @param z the context.
+   @param def the finished compression.
+*/
+static void tallyDeflater( LZW *z, Deflater const *def )
+{
+  if ( z->fullAt < 0 && def->fullAt >= 0 ) {
+    z->fullAt = z->rawBytes + def->fullAt;
+  }
+  z->codes += def->codes;
+  z->rawBytes += def->coded;
+}
+
+/* Finds the width of the next code. When widths vary, deflate wrote it at the
+   width for its dictionary size, which is one entry ahead of ours once there's
+   a previous word, since we only add that entry after reading this code.
+
+   @param d the dictionary being used for word searching.
+   @param prevIndex code of the previous word, NO_CODE if there isn't one.
+   @param bits number of bits indicated by argument.
+   @param variable true if code widths grow with the dictionary.
+   @return the number of bits in the next code.
+*/
+static int nextWidth( Dictionary *d, int prevIndex, int bits, bool variable )
+{
+  if ( !variable ) {
+    return bits;
+  }
+
+  long codes = d->dictLength + ( prevIndex != NO_CODE ? 1 : 0 );
+  return codeWidth( codes < d->dictSize ? codes : d->dictSize );
+}
+
+/** State of a decompression in progress. */
+typedef struct {
+  /** Dictionary being used for word searching. */
+  Dictionary *d;
+  /** Buffer the decoded words are appended to. */
+  Buffer *outBuffer;
+  /** Output position of the first byte still in outBuffer. Anything before
+      it has already been written out. */
+  long base;
+  /** Output position where each entry's word appears, so it can be copied
+      from earlier output instead of rebuilt from its prefix chain. */
+  long *where;
+  /** Number of entries where has room for. */
+  long whereCap;
+} Inflater;
+
+/* Records where a newly added entry's word appears in the output. The word
+   is the previous word plus one byte, so it starts where that word did.
+
+   @param z the decompression state.
+   @param code code of the new entry, or NO_CODE if the dictionary was full.
+   @param pos output position of the previous word.
+*/
+static void noteEntry( Inflater *z, int code, long pos )
+{
+  if ( code == NO_CODE ) {
+    return;
+  }
+
+  // Grows along with the dictionary's own entry arrays
+  if ( code >= z->whereCap ) {
+    z->whereCap = z->d->dictCap;
+    z->where = ( long * ) realloc( z->where, z->whereCap * sizeof( long ) );
+  }
+  z->where[ code ] = pos;
+}
+
+/* Appends the word for a code to the output, copying it from where it last
+   appeared if that's still in the buffer.
+
+   @param z the decompression state.
+   @param code code of the word being decoded.
+   @return the first byte of the word.
+*/
+static char decodeWord( Inflater *z, int code )
+{
+  Buffer *outBuffer = z->outBuffer;
+  int len = z->d->wordLen[ code ];
+
+  reserveBuffer( outBuffer, len );
+  char *dest = outBuffer->data + outBuffer->len;
+
+  if ( code < MIN_DICT_SIZE ) {
+    dest[ 0 ] = ( char ) code;
+  } else if ( z->where[ code ] >= z->base ) {
+    char *src = outBuffer->data + ( z->where[ code ] - z->base );
+
+    // A word made from the word just before it overlaps itself by one byte,
+    // so it has to be copied front to back
+    if ( src + len <= dest ) {
+      memcpy( dest, src, len );
+    } else {
+      for ( int i = 0; i < len; i++ ) {
+        dest[ i ] = src[ i ];
+      }
+    }
+  } else {
+    getWord( z->d, code, dest );
+  }
+
+  outBuffer->len += len;
+  return dest[ 0 ];
+}
+
+/* Decodes every code the reader supplies, appending the words to a buffer.
+
+   @param c the context being decompressed with.
+   @param reader the bit reader supplying the codes.
+   @param outBuffer the buffer the decoded words are appended to.
+   @param out stream the buffer is written to each time it fills a chunk, or
+          NULL to keep the whole output in the buffer.
+   @return true if every code was defined. Otherwise, returns false, leaving
+           the code in badCode.
+*/
+static bool inflateCodes( LZW *c, BitReader *reader, Buffer *outBuffer, FILE *out )
+{
+  Dictionary *d = c->d;
+  int bits = c->bits;
+  bool variable = c->variable;
+  unsigned int dictIndex;
+  int prevIndex = NO_CODE;
+  char prevFirst = 0;
+  long prevPos = 0;
+
+  // Fixed-width codes are unpacked a batch at a time
+  unsigned int batch[ CODE_BATCH ];
+  int next = 0, batchLen = 0;
+  // Huffman streams are decoded side by side, straight from the buffer
+  HuffCode *huff = c->huffmanInput ? c->huff : NULL;
+  if ( huff && !startDecoding( huff, reader->buffer->data + reader->pos,
+                               reader->buffer->len - reader->pos ) ) {
+    c->badCode = NO_CODE;
+    return false;
+  }
+
+  // The position table is kept in the context between calls
+  Inflater z = { d, outBuffer, 0, c->where, c->whereCap };
+  long codes = 0;
+  c->badCode = NO_CODE;
+
+  while ( true ) {
+    if ( variable && !huff ) {
+      if ( !readCode( reader, &dictIndex, nextWidth( d, prevIndex, bits, variable ) ) ) {
+        break;
+      }
+    } else {
+      if ( next == batchLen ) {
+        batchLen = huff ? decodeCodes( huff, batch, CODE_BATCH )
+                        : readCodes( reader, batch, CODE_BATCH, bits );
+        next = 0;
+        if ( batchLen == 0 ) {
+          break;
+        }
+      }
+      dictIndex = batch[ next++ ];
+    }
+    codes++;
+
+    // Start over with a fresh dictionary
+    if ( variable && dictIndex == CLEAR_CODE ) {
+      resetDictionary( d );
+      prevIndex = NO_CODE;
+      continue;
+    }
+
+    // The code the previous word plus one byte will get, which may be the
+    // code being read. A full dictionary that evicts words makes room for it
+    // first, just as deflate's did.
+    int nextCode = NO_CODE;
+    if ( prevIndex != NO_CODE && d->dictLength < d->dictSize ) {
+      nextCode = d->dictLength;
+    } else if ( prevIndex != NO_CODE && d->evict ) {
+      nextCode = makeRoom( d, prevIndex );
+    }
+    bool unadded = nextCode != NO_CODE && dictIndex == ( unsigned int ) nextCode;
+
+    // Check for invalid compression in file
+    if ( dictIndex >= ( unsigned int ) d->dictLength && !unadded ) {
+      c->badCode = dictIndex;
+      break;
+    }
+
+    long pos = z.base + outBuffer->len;
+
+    if ( unadded ) {
+      // A code for the entry not added yet is the previous word plus its own
+      // first byte, which is also the previous word's first byte
+      noteEntry( &z, addChild( d, prevIndex, prevFirst ), prevPos );
+      prevFirst = decodeWord( &z, dictIndex );
+    } else {
+      // The previous word plus the first byte of this one is the next entry
+      prevFirst = decodeWord( &z, dictIndex );
+      if ( prevIndex != NO_CODE ) {
+        noteEntry( &z, addChild( d, prevIndex, prevFirst ), prevPos );
+      }
+    }
+
+    // Deflate adds each entry right after writing the code for its prefix,
+    // so the dictionary counts as full from the end of the previous word
+    if ( c->fullAt < 0 && d->dictLength == d->dictSize ) {
+      c->fullAt = c->rawBytes + pos;
+    }
+
+    if ( out && outBuffer->len >= STREAM_CHUNK ) {
+      z.base += outBuffer->len;
+      writeChunk( outBuffer, out );
+    }
+
+    prevIndex = dictIndex;
+    prevPos = pos;
+  }
+
+  c->where = z.where;
+  c->whereCap = z.whereCap;
+  c->codes += codes;
+  c->rawBytes += z.base + outBuffer->len;
+  return c->badCode == NO_CODE;
+}
+
+LZW *lzwMake( int bits, bool variable, bool header )
+{
+  LZW *z = ( LZW * ) malloc( sizeof( LZW ) );
+
+  z->d = makeDictionary( bits );
+  z->bits = bits;
+  z->variable = variable;
+  z->header = header;
+  z->scratch = makeBuffer();
+  z->where = NULL;
+  z->whereCap = 0;
+  z->badCode = NO_CODE;
+  z->trained = false;
+  z->longestWord = 1;
+  z->maxEntries = 0;
+  z->huffman = false;
+  z->huffmanInput = false;
+  z->huff = NULL;
+  z->codes = 0;
+  z->rawBytes = 0;
+  z->fullAt = -1;
+  return z;
+}
+
+bool lzwUseDictionary( LZW *z, char const *filename )
+{
+  Dictionary *d = loadDictionary( filename );
+  if ( !d ) {
+    return false;
+  }
+
+  freeDictionary( z->d );
+  z->d = d;
+  z->trained = true;
+
+  // Trained words never appear earlier in the output, so inflate always
+  // rebuilds them from their prefix chains
+  z->whereCap = d->dictCap;
+  z->where = ( long * ) realloc( z->where, z->whereCap * sizeof( long ) );
+  FOR( i, z->whereCap )
+    z->where[ i ] = -1;
+
+  z->bits = MINIMUM_BITS;
+  while ( ( ( long ) 1 << z->bits ) < d->dictSize ) {
+    z->bits++;
+  }
+  z->variable = d->baseLength > CLEAR_CODE && d->wordLen[ CLEAR_CODE ] == 0;
+
+  z->longestWord = 1;
+  FOR( i, d->baseLength )
+    if ( d->wordLen[ i ] > z->longestWord )
+      z->longestWord = d->wordLen[ i ];
+  return true;
+}
+
+bool lzwSaveDictionary( LZW *z, char const *filename )
+{
+  return saveDictionary( z->d, filename );
+}
+
+void lzwFree( LZW *z )
+{
+  freeDictionary( z->d );
+  freeBuffer( z->scratch );
+  free( z->where );
+  if ( z->huff ) {
+    freeHuffCode( z->huff );
+  }
+  free( z );
+}
+
+bool lzwLimitMemory( LZW *z, long bytes )
+{
+  long entries = bytes / ( long ) DICT_ENTRY_BYTES;
+  if ( entries < MIN_DICT_ENTRIES ) {
+    return false;
+  }
+
+  // Codes are ints, so there's no use for more entries than they can number
+  z->maxEntries = entries < INT_MAX ? entries : INT_MAX;
+  return true;
+}
+
+/* Finds the context's Huffman code, making it if this is the first use.
+
+   @param z the context.
+   @return the Huffman code.
+*/
+static HuffCode *huffCode( LZW *z )
+{
+  if ( !z->huff ) {
+    z->huff = makeHuffCode();
+  }
+  return z->huff;
+}
+
+void lzwUseCodeTable( LZW *z, Header const *h )
+{
+  HuffCode *huff = huffCode( z );
+  z->huffmanInput = true;
+  memcpy( huff->lengths, h->lengths, HUFF_SYMBOLS );
+  memcpy( huff->sizes, h->sizes, sizeof( huff->sizes ) );
+}
+
+long lzwBound( LZW const *z, int len )
+{
+  // Every input byte could end up as its own code, plus a clear code every
+  // time the ratio is checked
+  long codes = ( long ) len + len / RATIO_CHECK + 1;
+  long header = z->header ? HEADER_LEN + ( z->maxEntries ? ENTRIES_BYTES : 0 ) : 0;
+  if ( z->huffman && z->header ) {
+    // A Huffman code is never longer than HUFF_MAX_LEN, and the most bits
+    // that follow it are three fewer than the code width. Each stream may
+    // end with part of a byte.
+    header += HUFF_HEADER_BYTES + HUFF_STREAMS;
+    return header + ( codes * ( z->bits + HUFF_MAX_LEN - HUFF_GROUP_BITS - 1 ) +
+                      HUFF_MAX_LEN + BBITS - 1 ) / BBITS;
+  }
+  return header + ( codes * z->bits + BBITS - 1 ) / BBITS;
+}
+
+/* Compresses a block of memory, appending the output to a buffer.
+
+   @param z the context being compressed with.
+   @param data the input.
+   @param len number of bytes in the input.
+   @param outBuffer the buffer the compressed data is appended to.
+*/
+static void deflateInto( LZW *z, char const *data, int len, Buffer *outBuffer )
+{
+  Deflater def;
+  HuffCode *huff = z->huffman && z->header ? huffCode( z ) : NULL;
+
+  useWidth( z, z->bits );
+  initDeflater( &def, z->d, z->bits, z->variable, huff );
+  if ( z->header && !huff ) {
+    emitHeader( z, outBuffer, len, NULL );
+  }
+  initWriter( &def.writer, outBuffer );
+
+  deflateBytes( &def, data, len );
+
+  // The Huffman code is built from every code, and goes in the header in
+  // front of them along with the stream sizes. Nothing has been written
+  // yet, so the header goes first. Codes the Huffman code wouldn't shrink
+  // are written plain.
+  if ( huff ) {
+    if ( def.match != NO_CODE ) {
+      emitCode( &def, def.match );
+      def.match = NO_CODE;
+    }
+    if ( planCode( huff ) ) {
+      encodeCodes( huff );
+      emitHeader( z, outBuffer, len, huff );
+      appendStreams( outBuffer, huff );
+      tallyDeflater( z, &def );
+      return;
+    }
+    emitHeader( z, outBuffer, len, NULL );
+  }
+  finishDeflater( &def );
+  tallyDeflater( z, &def );
+}
+
+int lzwCompress( LZW *z, char const *src, int len, char *dst, int cap )
+{
+  z->scratch->len = 0;
+  deflateInto( z, src, len, z->scratch );
+
+  if ( z->scratch->len > cap ) {
+    return LZW_NO_ROOM;
+  }
+  memcpy( dst, z->scratch->data, z->scratch->len );
+  return z->scratch->len;
+}
+
+int lzwDecompress( LZW *z, char const *src, int len, char *dst, int cap )
+{
+  long rawLen = UNKNOWN_LEN;
+  int skip = 0;
+
+  z->huffmanInput = false;
+  if ( z->header ) {
+    Header h;
+    if ( !readHeader( src, len, z->longestWord, &h ) ) {
+      return LZW_INVALID;
+    }
+    if ( h.length > cap ) {
+      return LZW_NO_ROOM;
+    }
+
+    // Codes written from a trained dictionary only make sense with it
+    bool variable = h.flags & FLAG_VARIABLE;
+    if ( z->trained && ( h.bits != z->bits || variable != z->variable ||
+                         ( h.flags & FLAG_EVICT ) ) ) {
+      return LZW_INVALID;
+    }
+    z->bits = h.bits;
+    z->variable = h.flags & FLAG_VARIABLE;
+    if ( !z->trained ) {
+      z->maxEntries = h.entries;
+    }
+    if ( h.flags & FLAG_HUFFMAN ) {
+      lzwUseCodeTable( z, &h );
+    }
+    rawLen = h.length;
+    skip = headerLength( src );
+  }
+
+  Buffer codes = { ( char * ) src + skip, len - skip, len - skip };
+  BitReader reader;
+
+  useWidth( z, z->bits );
+  z->scratch->len = 0;
+  initReader( &reader, &codes );
+  if ( !inflateCodes( z, &reader, z->scratch, NULL ) ||
+       ( rawLen != UNKNOWN_LEN && z->scratch->len != rawLen ) ) {
+    return LZW_INVALID;
+  }
+
+  if ( z->scratch->len > cap ) {
+    return LZW_NO_ROOM;
+  }
+  memcpy( dst, z->scratch->data, z->scratch->len );
+  return z->scratch->len;
+}
+
+Buffer *lzwDeflate( LZW *z, char const *data, int len )
+{
+  Buffer *outBuffer = makeBuffer();
+
+  deflateInto( z, data, len, outBuffer );
+  return outBuffer;
+}
+
+void lzwFreeBuffer( Buffer *buffer )
+{
+  freeBuffer( buffer );
+}
+
+void lzwDeflateStream( LZW *z, FILE *in, FILE *out )
+{
+  Buffer *inBuffer = makeBuffer();
+  Buffer *outBuffer = makeBuffer();
+  Deflater def;
+
+  // Pipes don't say how long they are, so their header can't either
+  useWidth( z, z->bits );
+  initDeflater( &def, z->d, z->bits, z->variable, NULL );
+  if ( z->header ) {
+    emitHeader( z, outBuffer, streamLength( in ), NULL );
+  }
+  initStreamWriter( &def.writer, outBuffer, out );
+
+  while ( readChunk( inBuffer, in ) > 0 ) {
+    deflateBytes( &def, inBuffer->data, inBuffer->len );
+  }
+
+  finishDeflater( &def );
+  tallyDeflater( z, &def );
+  freeBuffer( inBuffer );
+  freeBuffer( outBuffer );
+}
+
+void lzwDeflatePieces( LZW *z, long length, PieceSource source,
+                       PieceSink sink, Buffer *out, void *arg )
+{
+  Deflater def;
+
+  useWidth( z, z->bits );
+  initDeflater( &def, z->d, z->bits, z->variable, NULL );
+  if ( z->header ) {
+    emitHeader( z, out, length, NULL );
+  }
+  initWriter( &def.writer, out );
+
+  Buffer *piece;
+  while ( ( piece = source( arg ) ) ) {
+    deflateBytes( &def, piece->data, piece->len );
+
+    // Hand off the output once it fills a chunk, keeping any partial code
+    if ( def.writer.buffer->len >= STREAM_CHUNK ) {
+      def.writer.buffer = sink( def.writer.buffer, arg );
+    }
+  }
+
+  finishDeflater( &def );
+  tallyDeflater( z, &def );
+  freeBuffer( sink( def.writer.buffer, arg ) );
+}
+
+Buffer *lzwInflate( LZW *z, char const *data, int len, long rawLen )
+{
+  Buffer *outBuffer = makeBuffer();
+  Buffer codes = { ( char * ) data, len, len };
+  BitReader reader;
+
+  if ( rawLen != UNKNOWN_LEN ) {
+    reserveBuffer( outBuffer, rawLen );
+  }
+
+  useWidth( z, z->bits );
+  initReader( &reader, &codes );
+  if ( !inflateCodes( z, &reader, outBuffer, NULL ) ) {
+    freeBuffer( outBuffer );
+    return NULL;
+  }
+  return outBuffer;
+}
+
+/* Reads the rest of a stream onto the end of a buffer.
+
+   @param buffer the buffer the input is appended to.
+   @param in the stream being read.
+*/
+static void readRest( Buffer *buffer, FILE *in )
+{
+  int n;
+  do {
+    reserveBuffer( buffer, STREAM_CHUNK );
+    n = fread( buffer->data + buffer->len, sizeof( char ), STREAM_CHUNK, in );
+    buffer->len += n;
+  } while ( n > 0 );
+}
+
+bool lzwInflateStream( LZW *z, FILE *in, Buffer *inBuffer, int skip,
+                       FILE *out )
+{
+  Buffer *outBuffer = makeBuffer();
+  BitReader reader;
+
+  useWidth( z, z->bits );
+  if ( z->huffmanInput ) {
+    // The Huffman streams follow one another, so they're all read in before
+    // decoding any of them
+    readRest( inBuffer, in );
+    initReader( &reader, inBuffer );
+  } else {
+    initStreamReader( &reader, inBuffer, in );
+  }
+  reader.pos = skip;
+  bool ok = inflateCodes( z, &reader, outBuffer, out );
+  writeChunk( outBuffer, out );
+
+  freeBuffer( outBuffer );
+  return ok;
+}
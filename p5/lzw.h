@@ -0,0 +1,245 @@
+/**
+   @file lzw.h
+   @author Stephen Gonsalves (dkgonsal)
+
+   The lzw file is the LZW compressor and decompressor, used by the deflate
+   and inflate programs and built into the liblzw library so other programs
+   can compress data in memory. An LZW context holds the code width and
+   options along with the dictionary and scratch space, so compressing many
+   payloads with the same context doesn't allocate them again for each one.
+   Nothing here exits the program; errors are returned to the caller.
+*/
+
+#ifndef _LZW_H_
+#define _LZW_H_
+
+#include "buffer.h"
+#include "dictionary.h"
+#include "header.h"
+
+/** Marks what the liblzw library exports. Everything else in it is built
+    hidden, so its helpers can't collide with another library's names. */
+#define LZW_API __attribute__(( visibility( "default" ) ))
+
+/** Returned when the output doesn't fit in the space given for it */
+#define LZW_NO_ROOM -1
+/** Returned when compressed data can't be decoded */
+#define LZW_INVALID -2
+
+/** A compressor and decompressor that can be used over and over. */
+typedef struct {
+  /** Dictionary, reset at the start of each call. */
+  Dictionary *d;
+  /** Number of bits in each code, or the largest width when widths vary. */
+  int bits;
+  /** True if code widths grow with the dictionary and clear codes are sent. */
+  bool variable;
+  /** True if compressed data starts with a header. */
+  bool header;
+  /** Output of the last call to lzwCompress() or lzwDecompress(). */
+  Buffer *scratch;
+  /** Output position of each entry's word while decompressing. */
+  long *where;
+  /** Number of entries where has room for. */
+  long whereCap;
+  /** Code that stopped the last decompression, or NO_CODE. */
+  int badCode;
+  /** True if every call starts from a dictionary loaded by
+      lzwUseDictionary(). */
+  bool trained;
+  /** Number of bytes in the longest word the dictionary starts with, 1
+      unless it's trained. */
+  int longestWord;
+  /** Most entries the dictionary may hold, evicting its least recently used
+      words once it's full, or 0 if it never evicts. */
+  long maxEntries;
+  /** True if lzwDeflate() and lzwCompress() write the codes in a static
+      Huffman code, which goes in the header, so it only applies with a
+      header. The stream functions can't hold every code back and write them
+      plain. */
+  bool huffman;
+  /** True if lzwInflate() and lzwInflateStream() read codes written in the
+      Huffman code, as set by lzwUseCodeTable() from a header. */
+  bool huffmanInput;
+  /** Huffman code, made the first time one is used. */
+  HuffCode *huff;
+  /** Number of codes written or read so far. */
+  long codes;
+  /** Number of uncompressed bytes compressed or decompressed so far. */
+  long rawBytes;
+  /** Value rawBytes had when the dictionary first filled, or -1 if it
+      hasn't yet. */
+  long fullAt;
+} LZW;
+
+/* Makes a context for compressing and decompressing with the given options.
+
+   @param bits is the number of bits in each code, or the largest width when
+          widths vary.
+   @param variable is true if code widths grow with the dictionary.
+   @param header is true if compressed data starts with a header. When
+          decompressing, the header's width, flags and entry limit replace
+          the context's.
+   @return the new context.
+*/
+LZW_API LZW *lzwMake( int bits, bool variable, bool header );
+
+/* Frees a context and everything it holds.
+
+   @param z is the context being freed.
+*/
+LZW_API void lzwFree( LZW *z );
+
+/* Makes every later call start from a trained dictionary saved with
+   lzwSaveDictionary(), instead of from just the single bytes. The code width
+   and whether widths vary are taken from the dictionary, and the same
+   dictionary has to be used to decompress.
+
+   @param z is the context that will use the dictionary.
+   @param filename is the name of the saved dictionary.
+   @return true if the dictionary was loaded. Otherwise, returns false and
+           the context is unchanged.
+*/
+LZW_API bool lzwUseDictionary( LZW *z, char const *filename );
+
+/* Saves the dictionary as the last call left it, so a later context can
+   start from it with lzwUseDictionary().
+
+   @param z is the context whose dictionary is saved.
+   @param filename is the name of the file it's saved in.
+   @return true if the dictionary was saved. Otherwise, returns false.
+*/
+LZW_API bool lzwSaveDictionary( LZW *z, char const *filename );
+
+/* Caps the memory the dictionary may use. Once it holds as many entries as
+   fit, each new word takes the place of the least recently used word that
+   no other word extends, so compression keeps adapting to the input. The
+   same cap has to be used to decompress, and it's recorded in the header if
+   there is one. Doesn't apply to a trained dictionary.
+
+   @param z is the context whose dictionary is capped.
+   @param bytes is the most bytes of memory the dictionary's entries may use.
+   @return true if the cap leaves room for enough entries. Otherwise, returns
+           false and the context is unchanged.
+*/
+LZW_API bool lzwLimitMemory( LZW *z, long bytes );
+
+/* Makes later calls to lzwInflate() and lzwInflateStream() read codes
+   written in the Huffman code described by a header.
+
+   @param z is the context being decompressed with.
+   @param h is a header read by readHeader() with FLAG_HUFFMAN set.
+*/
+LZW_API void lzwUseCodeTable( LZW *z, Header const *h );
+
+/* Finds the most bytes lzwCompress() can produce for an input.
+
+   @param z is the context the input will be compressed with.
+   @param len is the number of bytes in the input.
+   @return the largest size of the compressed output.
+*/
+LZW_API long lzwBound( LZW const *z, int len );
+
+/* Compresses a block of memory into space the caller gives.
+
+   @param z is the context being compressed with.
+   @param src is the input.
+   @param len is the number of bytes in the input.
+   @param dst is where the compressed data is stored.
+   @param cap is the number of bytes dst has room for.
+   @return the number of compressed bytes, or LZW_NO_ROOM if they didn't fit.
+*/
+LZW_API int lzwCompress( LZW *z, char const *src, int len, char *dst, int cap );
+
+/* Decompresses a block of memory into space the caller gives.
+
+   @param z is the context being decompressed with.
+   @param src is the compressed data.
+   @param len is the number of bytes of compressed data.
+   @param dst is where the decompressed data is stored.
+   @param cap is the number of bytes dst has room for.
+   @return the number of decompressed bytes, LZW_NO_ROOM if they didn't fit
+           or LZW_INVALID if the compressed data is damaged.
+*/
+LZW_API int lzwDecompress( LZW *z, char const *src, int len, char *dst, int cap );
+
+/* Compresses a block of memory into a new buffer.
+
+   @param z is the context being compressed with.
+   @param data is the input.
+   @param len is the number of bytes in the input.
+   @return a buffer holding the compressed data.
+*/
+LZW_API Buffer *lzwDeflate( LZW *z, char const *data, int len );
+
+/* Frees a buffer returned by lzwDeflate() or lzwInflate().
+
+   @param buffer is the buffer being freed.
+*/
+LZW_API void lzwFreeBuffer( Buffer *buffer );
+
+/* Compresses a stream, reading and writing a chunk at a time so memory use
+   doesn't depend on the size of the input.
+
+   @param z is the context being compressed with.
+   @param in is the stream being compressed.
+   @param out is the stream the compressed data is written to.
+*/
+LZW_API void lzwDeflateStream( LZW *z, FILE *in, FILE *out );
+
+/** Gets the next piece of input for lzwDeflatePieces(), or NULL at the end.
+    The piece returned by the last call is no longer needed once this is
+    called. */
+typedef Buffer *( *PieceSource )( void *arg );
+
+/** Takes a buffer of output from lzwDeflatePieces(), and gives back an empty
+    buffer for it to keep writing to. The one given back after the last
+    buffer of output is freed. */
+typedef Buffer *( *PieceSink )( Buffer *full, void *arg );
+
+/* Compresses input that arrives a piece at a time, handing the output on a
+   buffer at a time, so the input can be read and the output written on other
+   threads while this one compresses. The output is the same as from
+   lzwDeflateStream().
+
+   @param z is the context being compressed with.
+   @param length is the number of bytes in the input for the header, or
+          UNKNOWN_LEN.
+   @param source gets each piece of input.
+   @param sink takes each buffer of output, including the last.
+   @param out is the first buffer the output is written to.
+   @param arg is passed to source and sink.
+*/
+LZW_API void lzwDeflatePieces( LZW *z, long length, PieceSource source,
+                               PieceSink sink, Buffer *out, void *arg );
+
+/* Decompresses codes, with no header in front of them, into a new buffer.
+
+   @param z is the context being decompressed with.
+   @param data is the compressed codes.
+   @param len is the number of bytes of codes.
+   @param rawLen is the number of bytes the output will have, or UNKNOWN_LEN,
+          so the output can be allocated once up front.
+   @return a buffer holding the decompressed data, or NULL if a code wasn't
+           defined. The code is left in badCode.
+*/
+LZW_API Buffer *lzwInflate( LZW *z, char const *data, int len, long rawLen );
+
+/* Decompresses a stream of codes, with no header in front of them, reading
+   and writing a chunk at a time so memory use doesn't depend on the size of
+   the input. Huffman coded codes are the exception, and are read in whole
+   before any is decoded.
+
+   @param z is the context being decompressed with.
+   @param in is the stream of codes.
+   @param inBuffer is the buffer holding the first chunk of the stream.
+   @param skip is the number of bytes at the start of the first chunk that
+          aren't codes.
+   @param out is the stream the decompressed data is written to.
+   @return true if every code was defined. Otherwise, returns false, leaving
+           the code in badCode.
+*/
+LZW_API bool lzwInflateStream( LZW *z, FILE *in, Buffer *inBuffer, int skip,
+                               FILE *out );
+
+#endif
@@ -0,0 +1,194 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lzw.h"
+
+/** Number of bytes in the test payloads */
+#define PAYLOAD_LEN 100000
+
+// Compress and decompress a payload with the given context, making sure
+// it comes back the same.
+static void roundTrip( LZW *z, char const *src, int len )
+{
+  long bound = lzwBound( z, len );
+  char *packed = ( char * ) malloc( bound );
+  char *unpacked = ( char * ) malloc( len + 1 );
+
+  int packedLen = lzwCompress( z, src, len, packed, bound );
+  assert( packedLen >= 0 && packedLen <= bound );
+
+  int unpackedLen = lzwDecompress( z, packed, packedLen, unpacked, len + 1 );
+  assert( unpackedLen == len );
+  assert( memcmp( src, unpacked, len ) == 0 );
+
+  free( packed );
+  free( unpacked );
+}
+
+int main()
+{
+  // A payload that compresses well, and one that doesn't.
+  char *text = ( char * ) malloc( PAYLOAD_LEN );
+  char *noise = ( char * ) malloc( PAYLOAD_LEN );
+  srand( 230 );
+  for ( int i = 0; i < PAYLOAD_LEN; i++ ) {
+    text[ i ] = "the quick brown fox "[ ( i * 7 + i / 13 ) % 20 ];
+    noise[ i ] = rand();
+  }
+
+  // Use the same context for several payloads, one after another.
+  LZW *z = lzwMake( 12, false, false );
+  roundTrip( z, text, PAYLOAD_LEN );
+  roundTrip( z, noise, PAYLOAD_LEN );
+  roundTrip( z, text, 1 );
+  roundTrip( z, text, 0 );
+  roundTrip( z, text, PAYLOAD_LEN );
+  lzwFree( z );
+
+  // Same with variable width codes and a header.
+  z = lzwMake( 16, true, true );
+  roundTrip( z, noise, PAYLOAD_LEN );
+  roundTrip( z, text, PAYLOAD_LEN );
+  lzwFree( z );
+
+  /////////////////////////////////////////////////////
+
+  // A dictionary capped at a few entries evicts words instead of filling up,
+  // and inflate evicts the same ones. The cap goes in the header.
+  z = lzwMake( 16, false, false );
+  assert( !lzwLimitMemory( z, 1000 ) );
+  assert( lzwLimitMemory( z, 30000 ) );
+  roundTrip( z, text, PAYLOAD_LEN );
+  roundTrip( z, noise, PAYLOAD_LEN );
+  assert( z->d->dictSize == z->maxEntries && z->d->dictLength == z->d->dictSize );
+  lzwFree( z );
+
+  z = lzwMake( 12, true, true );
+  assert( lzwLimitMemory( z, 50000 ) );
+  roundTrip( z, noise, PAYLOAD_LEN );
+  roundTrip( z, text, PAYLOAD_LEN );
+
+  LZW *plain = lzwMake( 12, true, true );
+  long entries = z->maxEntries;
+  long packedBound = lzwBound( z, PAYLOAD_LEN );
+  char *evicted = ( char * ) malloc( packedBound );
+  char *back = ( char * ) malloc( PAYLOAD_LEN );
+  int evictedLen = lzwCompress( z, noise, PAYLOAD_LEN, evicted, packedBound );
+  assert( lzwDecompress( plain, evicted, evictedLen, back, PAYLOAD_LEN ) == PAYLOAD_LEN );
+  assert( plain->maxEntries == entries && memcmp( back, noise, PAYLOAD_LEN ) == 0 );
+  free( evicted );
+  free( back );
+  lzwFree( plain );
+  lzwFree( z );
+
+  /////////////////////////////////////////////////////
+
+  // Codes written in a Huffman code come out smaller, and decompress from
+  // the header alone. When the Huffman code wouldn't help, the codes are
+  // written plain, so the output is never bigger.
+  z = lzwMake( 16, false, true );
+  z->huffman = true;
+  roundTrip( z, text, PAYLOAD_LEN );
+  roundTrip( z, noise, PAYLOAD_LEN );
+  roundTrip( z, text, 1 );
+  roundTrip( z, text, 0 );
+
+  LZW *fixed = lzwMake( 16, false, true );
+  plain = lzwMake( 9, false, true );
+  long huffBound = lzwBound( z, PAYLOAD_LEN );
+  char *coded = ( char * ) malloc( huffBound );
+  char *uncoded = ( char * ) malloc( huffBound );
+  back = ( char * ) malloc( PAYLOAD_LEN );
+  int codedLen = lzwCompress( z, text, PAYLOAD_LEN, coded, huffBound );
+  assert( codedLen < lzwCompress( fixed, text, PAYLOAD_LEN, uncoded, huffBound ) );
+  assert( lzwDecompress( plain, coded, codedLen, back, PAYLOAD_LEN ) == PAYLOAD_LEN );
+  assert( memcmp( back, text, PAYLOAD_LEN ) == 0 );
+
+  assert( lzwCompress( z, noise, PAYLOAD_LEN, coded, huffBound ) <=
+          lzwCompress( fixed, noise, PAYLOAD_LEN, uncoded, huffBound ) );
+  free( coded );
+  free( uncoded );
+  free( back );
+  lzwFree( plain );
+  lzwFree( fixed );
+  lzwFree( z );
+
+  // Same with variable width codes.
+  z = lzwMake( 16, true, true );
+  z->huffman = true;
+  roundTrip( z, text, PAYLOAD_LEN );
+  roundTrip( z, noise, PAYLOAD_LEN );
+  lzwFree( z );
+
+  /////////////////////////////////////////////////////
+
+  // Output that doesn't fit is reported, not written past.
+  z = lzwMake( 9, false, true );
+  char small[ 16 ];
+  assert( lzwCompress( z, noise, PAYLOAD_LEN, small, sizeof( small ) ) == LZW_NO_ROOM );
+
+  long bound = lzwBound( z, PAYLOAD_LEN );
+  char *packed = ( char * ) malloc( bound );
+  int packedLen = lzwCompress( z, text, PAYLOAD_LEN, packed, bound );
+  assert( lzwDecompress( z, packed, packedLen, small, sizeof( small ) ) == LZW_NO_ROOM );
+
+  // Damaged data is reported too, and the context still works afterward.
+  char *unpacked = ( char * ) malloc( PAYLOAD_LEN );
+  packed[ 0 ] = 0;
+  assert( lzwDecompress( z, packed, packedLen, unpacked, PAYLOAD_LEN ) == LZW_INVALID );
+
+  LZW *raw = lzwMake( 9, false, false );
+  char bad[] = { ( char ) 0xFF, ( char ) 0xFF };
+  assert( lzwDecompress( raw, bad, sizeof( bad ), unpacked, PAYLOAD_LEN ) == LZW_INVALID );
+  assert( raw->badCode == 511 );
+  roundTrip( raw, text, PAYLOAD_LEN );
+  lzwFree( raw );
+
+  free( packed );
+  free( unpacked );
+  lzwFree( z );
+
+  /////////////////////////////////////////////////////
+
+  // Train a dictionary on the text and save it.
+  z = lzwMake( 14, true, false );
+  lzwFreeBuffer( lzwDeflate( z, text, PAYLOAD_LEN / 2 ) );
+  assert( lzwSaveDictionary( z, "lzwTest.dict" ) );
+  lzwFree( z );
+
+  // Small messages like the sample come out smaller from the trained
+  // dictionary, and every one starts from it again.
+  z = lzwMake( 9, false, false );
+  assert( lzwUseDictionary( z, "lzwTest.dict" ) );
+  assert( z->bits == 14 && z->variable );
+
+  LZW *cold = lzwMake( 14, true, false );
+  char msg[ 200 ], coldMsg[ 200 ];
+  for ( int i = 0; i < 50; i++ ) {
+    char const *src = text + PAYLOAD_LEN / 2 + i * 100;
+    roundTrip( z, src, 100 );
+    assert( lzwCompress( z, src, 100, msg, sizeof( msg ) ) <
+            lzwCompress( cold, src, 100, coldMsg, sizeof( coldMsg ) ) );
+  }
+  roundTrip( z, noise, PAYLOAD_LEN );
+  roundTrip( z, text, 10 );
+  lzwFree( cold );
+
+  // A damaged dictionary file isn't used.
+  FILE *fp = fopen( "lzwTest.dict", "r+b" );
+  fseek( fp, -1, SEEK_END );
+  fputc( 0, fp );
+  fputc( 0, fp );
+  fclose( fp );
+  assert( !lzwUseDictionary( z, "lzwTest.dict" ) );
+  roundTrip( z, text, 100 );
+  remove( "lzwTest.dict" );
+
+  lzwFree( z );
+  free( text );
+  free( noise );
+
+  return EXIT_SUCCESS;
+}
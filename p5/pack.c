@@ -0,0 +1,86 @@
+/**
+   @file pack.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The pack file writes fixed-width codes in batches. There is a packer for
+   each code width, generated from the same loop, so its shifts and masks
+   are constants and the compiler can unroll it. The packer for a width is
+   looked up once per batch.
+*/
+
+#include "pack.h"
+
+/** A packer for one code width */
+typedef void (*Packer)( BitWriter *w, unsigned int const *codes, int n );
+
+/* Packs codes into the writer's buffer, which already has room for them.
+   Inlined into each packer with bits as a constant.
+
+   @param w is the bit writer receiving the codes.
+   @param codes is the values being written.
+   @param n is the number of codes.
+   @param bits is the number of bits in each code.
+*/
+static inline __attribute__(( always_inline ))
+void packFixed( BitWriter *w, unsigned int const *codes, int n, int bits )
+{
+  unsigned long long acc = w->acc;
+  int count = w->count;
+  unsigned char *dest = ( unsigned char * ) w->buffer->data + w->buffer->len;
+
+  for ( int i = 0; i < n; i++ ) {
+    // There are always fewer than WRITE_BITS bits waiting, so this can't overflow
+    acc = ( acc << bits ) | ( codes[ i ] & ( ( 1ULL << bits ) - 1 ) );
+    count += bits;
+
+    if ( count >= WRITE_BITS ) {
+      count -= WRITE_BITS;
+      unsigned int word = ( unsigned int ) ( acc >> count );
+      for ( int j = 0; j < WRITE_BITS / BBITS; j++ ) {
+        dest[ j ] = ( unsigned char ) ( word >> ( WRITE_BITS - BBITS * ( j + 1 ) ) );
+      }
+      dest += WRITE_BITS / BBITS;
+    }
+  }
+
+  w->acc = acc;
+  w->count = count;
+  w->buffer->len = ( char * ) dest - w->buffer->data;
+}
+
+/** Defines the packer for one code width */
+#define PACKER( B ) \
+  static void pack##B( BitWriter *w, unsigned int const *codes, int n ) \
+  { packFixed( w, codes, n, B ); }
+
+PACKER( 8 ) PACKER( 9 ) PACKER( 10 ) PACKER( 11 ) PACKER( 12 )
+PACKER( 13 ) PACKER( 14 ) PACKER( 15 ) PACKER( 16 ) PACKER( 17 )
+PACKER( 18 ) PACKER( 19 ) PACKER( 20 ) PACKER( 21 ) PACKER( 22 )
+PACKER( 23 ) PACKER( 24 ) PACKER( 25 ) PACKER( 26 ) PACKER( 27 )
+PACKER( 28 ) PACKER( 29 ) PACKER( 30 ) PACKER( 31 ) PACKER( 32 )
+
+/** Packer for each code width, starting at PACK_MIN_BITS */
+static Packer const packers[ PACK_MAX_BITS - PACK_MIN_BITS + 1 ] = {
+  pack8, pack9, pack10, pack11, pack12, pack13, pack14, pack15, pack16,
+  pack17, pack18, pack19, pack20, pack21, pack22, pack23, pack24, pack25,
+  pack26, pack27, pack28, pack29, pack30, pack31, pack32
+};
+
+void writeCodes( BitWriter *w, unsigned int const *codes, int n, int bits )
+{
+  if ( bits < PACK_MIN_BITS || bits > PACK_MAX_BITS ) {
+    for ( int i = 0; i < n; i++ ) {
+      writeCode( w, codes[ i ], bits );
+    }
+    return;
+  }
+
+  // Room for every whole word the batch can finish
+  reserveBuffer( w->buffer, ( int ) ( ( ( long ) n * bits + w->count ) / WRITE_BITS
+                                      * ( WRITE_BITS / BBITS ) ) );
+  packers[ bits - PACK_MIN_BITS ]( w, codes, n );
+
+  if ( w->fp && w->buffer->len >= STREAM_CHUNK ) {
+    writeChunk( w->buffer, w->fp );
+  }
+}
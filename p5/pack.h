@@ -0,0 +1,31 @@
+/**
+   @file pack.h
+   @author Stephen Gonsalves (dkgonsal)
+
+   The pack file writes fixed-width codes in batches. There is a packer for
+   each code width, generated from the same loop, so its shifts and masks
+   are constants and the compiler can unroll it. The packer for a width is
+   looked up once per batch.
+*/
+
+#ifndef _PACK_H_
+#define _PACK_H_
+
+#include "buffer.h"
+
+/** Narrowest code width with its own packer and unpacker */
+#define PACK_MIN_BITS 8
+/** Widest code width with its own packer and unpacker */
+#define PACK_MAX_BITS 32
+
+/* Writes a batch of codes that all have the same width. Gives the same bits
+   as calling writeCode() for each.
+
+   @param w is the bit writer receiving the codes.
+   @param codes is the values being written.
+   @param n is the number of codes.
+   @param bits is the number of bits in each code, at most 32.
+*/
+void writeCodes( BitWriter *w, unsigned int const *codes, int n, int bits );
+
+#endif
@@ -0,0 +1,215 @@
+/**
+   @file pipeline.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The pipeline file compresses a stream on three threads, so reading the
+   input and writing the output overlap with compressing it.
+*/
+
+#include "pipeline.h"
+#include <pthread.h>
+
+/** Most chunks a queue holds, every chunk in one direction plus the end */
+#define QUEUE_CAP ( PIPE_DEPTH + 2 )
+
+/** Chunks passed from one stage to another, oldest first. NULL marks the end. */
+typedef struct {
+  /** Chunks in the queue, as a ring. */
+  Buffer *items[ QUEUE_CAP ];
+  /** Index of the oldest chunk. */
+  int head;
+  /** Number of chunks in the queue. */
+  int count;
+  /** Lock protecting the queue. */
+  pthread_mutex_t lock;
+  /** Signalled each time a chunk is added or removed. */
+  pthread_cond_t changed;
+} Queue;
+
+/** Queues connecting the three stages. */
+typedef struct {
+  /** Stream being compressed. */
+  FILE *in;
+  /** Stream the compressed data is written to. */
+  FILE *out;
+  /** Input chunks ready to compress. */
+  Queue full;
+  /** Input chunks ready to be filled again. */
+  Queue empty;
+  /** Output chunks ready to write. */
+  Queue done;
+  /** Output chunks ready to be written to again. */
+  Queue spare;
+  /** Input chunk the compressor is working on, or NULL. */
+  Buffer *piece;
+} Pipeline;
+
+/* Starts an empty queue.
+
+   @param q the queue being initialized.
+*/
+static void initQueue( Queue *q )
+{
+  q->head = 0;
+  q->count = 0;
+  pthread_mutex_init( &q->lock, NULL );
+  pthread_cond_init( &q->changed, NULL );
+}
+
+/* Frees the chunks left in a queue and its lock.
+
+   @param q the queue being freed.
+*/
+static void freeQueue( Queue *q )
+{
+  for ( int i = 0; i < q->count; i++ ) {
+    Buffer *b = q->items[ ( q->head + i ) % QUEUE_CAP ];
+    if ( b ) {
+      freeBuffer( b );
+    }
+  }
+
+  pthread_mutex_destroy( &q->lock );
+  pthread_cond_destroy( &q->changed );
+}
+
+/* Adds a chunk to the back of a queue, waiting for room if it's full.
+
+   @param q the queue being added to.
+   @param b the chunk, or NULL to mark the end.
+*/
+static void pushQueue( Queue *q, Buffer *b )
+{
+  pthread_mutex_lock( &q->lock );
+  while ( q->count == QUEUE_CAP ) {
+    pthread_cond_wait( &q->changed, &q->lock );
+  }
+
+  q->items[ ( q->head + q->count ) % QUEUE_CAP ] = b;
+  q->count++;
+  pthread_cond_broadcast( &q->changed );
+  pthread_mutex_unlock( &q->lock );
+}
+
+/* Takes the chunk at the front of a queue, waiting for one if it's empty.
+
+   @param q the queue being taken from.
+   @return the chunk, or NULL at the end.
+*/
+static Buffer *popQueue( Queue *q )
+{
+  pthread_mutex_lock( &q->lock );
+  while ( q->count == 0 ) {
+    pthread_cond_wait( &q->changed, &q->lock );
+  }
+
+  Buffer *b = q->items[ q->head ];
+  q->head = ( q->head + 1 ) % QUEUE_CAP;
+  q->count--;
+  pthread_cond_broadcast( &q->changed );
+  pthread_mutex_unlock( &q->lock );
+  return b;
+}
+
+/* Reader thread, filling empty input chunks from the stream until it ends.
+
+   @param arg the pipeline.
+   @return NULL.
+*/
+static void *readStage( void *arg )
+{
+  Pipeline *p = ( Pipeline * ) arg;
+
+  while ( true ) {
+    Buffer *b = popQueue( &p->empty );
+    if ( readChunk( b, p->in ) == 0 ) {
+      pushQueue( &p->empty, b );
+      pushQueue( &p->full, NULL );
+      return NULL;
+    }
+    pushQueue( &p->full, b );
+  }
+}
+
+/* Writer thread, writing out compressed chunks until the last one.
+
+   @param arg the pipeline.
+   @return NULL.
+*/
+static void *writeStage( void *arg )
+{
+  Pipeline *p = ( Pipeline * ) arg;
+  Buffer *b;
+
+  while ( ( b = popQueue( &p->done ) ) ) {
+    writeChunk( b, p->out );
+    pushQueue( &p->spare, b );
+  }
+  return NULL;
+}
+
+/* Gives the compressor its next input chunk, sending the last one back to
+   the reader.
+
+   @param arg the pipeline.
+   @return the next chunk, or NULL at the end of the input.
+*/
+static Buffer *nextPiece( void *arg )
+{
+  Pipeline *p = ( Pipeline * ) arg;
+
+  if ( p->piece ) {
+    pushQueue( &p->empty, p->piece );
+  }
+  p->piece = popQueue( &p->full );
+  return p->piece;
+}
+
+/* Sends a compressed chunk to the writer and gives the compressor a spare
+   one to carry on with.
+
+   @param full the chunk of compressed output.
+   @param arg the pipeline.
+   @return an empty chunk.
+*/
+static Buffer *sendPiece( Buffer *full, void *arg )
+{
+  Pipeline *p = ( Pipeline * ) arg;
+
+  pushQueue( &p->done, full );
+  return popQueue( &p->spare );
+}
+
+void deflatePipeline( LZW *z, FILE *in, FILE *out )
+{
+  Pipeline p = { in, out };
+  initQueue( &p.full );
+  initQueue( &p.empty );
+  initQueue( &p.done );
+  initQueue( &p.spare );
+  p.piece = NULL;
+
+  for ( int i = 0; i < PIPE_DEPTH; i++ ) {
+    pushQueue( &p.empty, makeBuffer() );
+    pushQueue( &p.spare, makeBuffer() );
+  }
+
+  pthread_t reader, writer;
+  if ( pthread_create( &reader, NULL, readStage, &p ) != 0 ||
+       pthread_create( &writer, NULL, writeStage, &p ) != 0 ) {
+    fprintf( stderr, "Can't create pipeline thread\n" );
+    exit( 1 );
+  }
+
+  // Pipes don't say how long they are, so their header can't either
+  lzwDeflatePieces( z, streamLength( in ), nextPiece, sendPiece, makeBuffer(), &p );
+
+  pushQueue( &p.done, NULL );
+  pthread_join( reader, NULL );
+  pthread_join( writer, NULL );
+
+  freeQueue( &p.full );
+  freeQueue( &p.empty );
+  freeQueue( &p.done );
+  freeQueue( &p.spare );
+}
@@ -0,0 +1,30 @@
+/**
+   @file pipeline.h
+   @author Stephen Gonsalves (dkgonsal)
+
+   The pipeline file compresses a stream on three threads, so reading the
+   input and writing the output overlap with compressing it. A reader thread
+   fills input chunks, the calling thread compresses them and a writer thread
+   writes out the compressed chunks. The stages pass chunks through bounded
+   queues, and each direction has a fixed set of chunks that go around and
+   around, so memory use doesn't depend on the size of the input.
+*/
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include "lzw.h"
+
+/** Number of chunks going around between each pair of stages */
+#define PIPE_DEPTH 2
+
+/* Compresses a stream with reading, compressing and writing on separate
+   threads. The output is the same as from lzwDeflateStream().
+
+   @param z is the context being compressed with.
+   @param in is the stream being compressed.
+   @param out is the stream the compressed data is written to.
+*/
+void deflatePipeline( LZW *z, FILE *in, FILE *out );
+
+#endif
@@ -0,0 +1,76 @@
+/**
+   @file stats.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The stats file times the phases of a deflate or inflate run and reports
+   them for -s.
+*/
+
+#include "stats.h"
+#include <time.h>
+#include <sys/resource.h>
+
+/** Names the phases are reported under */
+static char const *phaseNames[ PHASES ] = { "read_seconds", "code_seconds", "write_seconds" };
+
+/* Reads a clock that only ever moves forward.
+
+   @return the time in seconds.
+*/
+static double wallClock( void )
+{
+  struct timespec t;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void startStats( Stats *s )
+{
+  for ( int p = 0; p < PHASES; p++ ) {
+    s->seconds[ p ] = 0;
+  }
+  s->packedBytes = UNKNOWN_LEN;
+  s->mark = wallClock();
+}
+
+void endPhase( Stats *s, Phase p )
+{
+  double now = wallClock();
+  s->seconds[ p ] += now - s->mark;
+  s->mark = now;
+}
+
+long streamBytes( FILE *fp )
+{
+  long pos = ftell( fp );
+  return pos < 0 ? UNKNOWN_LEN : pos;
+}
+
+void printStats( Stats const *s, LZW const *z )
+{
+  for ( int p = 0; p < PHASES; p++ ) {
+    fprintf( stderr, "%s=%.6f\n", phaseNames[ p ], s->seconds[ p ] );
+  }
+
+  if ( s->packedBytes != UNKNOWN_LEN ) {
+    fprintf( stderr, "packed_bytes=%ld\n", s->packedBytes );
+  }
+
+  if ( z ) {
+    fprintf( stderr, "raw_bytes=%ld\n", z->rawBytes );
+    fprintf( stderr, "codes=%ld\n", z->codes );
+
+    // Per code and per byte figures of an empty input come out as 0
+    double codes = z->codes ? z->codes : 1;
+    double bytes = z->rawBytes ? z->rawBytes : 1;
+    fprintf( stderr, "avg_match=%.3f\n", z->rawBytes / codes );
+    fprintf( stderr, "dict_full_at=%ld\n", z->fullAt );
+    fprintf( stderr, "lookups_per_byte=%.3f\n", z->d->lookups / bytes );
+    fprintf( stderr, "probes_per_byte=%.3f\n", z->d->probes / bytes );
+  }
+
+  // Linux gives the peak resident set size in kilobytes
+  struct rusage usage;
+  getrusage( RUSAGE_SELF, &usage );
+  fprintf( stderr, "peak_rss_kb=%ld\n", usage.ru_maxrss );
+}
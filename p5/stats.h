@@ -0,0 +1,67 @@
+/**
+   @file stats.h
+   @author Stephen Gonsalves (dkgonsal)
+
+   The stats file times the phases of a deflate or inflate run and reports
+   them for -s, along with what the context counted: how many codes there
+   were, when the dictionary filled, how much searching the dictionary did
+   for each byte and the most memory the run held. Each figure goes on its
+   own line of standard error as name=value, so scripts can pick out the
+   ones they want.
+
+   The dictionary fills at the same point on both sides, given as the number
+   of uncompressed bytes up to the end of the word its last entry extends.
+   Only deflate searches the dictionary, so inflate's lookups and probes
+   are always 0. Looking words up in the dictionary and packing their codes
+   into bits happen together, a code at a time, so both are timed as
+   coding.
+*/
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include "lzw.h"
+
+/** Phases of a run that are timed separately */
+typedef enum { PHASE_READ, PHASE_CODE, PHASE_WRITE, PHASES } Phase;
+
+/** Timings of a run. */
+typedef struct {
+  /** Seconds spent in each phase. */
+  double seconds[ PHASES ];
+  /** When the last phase ended, in seconds. */
+  double mark;
+  /** Number of compressed bytes written or read, or UNKNOWN_LEN. */
+  long packedBytes;
+} Stats;
+
+/* Starts timing a run, with no time charged to any phase yet.
+
+   @param s is the timings being started.
+*/
+void startStats( Stats *s );
+
+/* Charges the time since the last phase ended, or since the run started, to
+   a phase.
+
+   @param s is the timings of the run.
+   @param p is the phase that just ended.
+*/
+void endPhase( Stats *s, Phase p );
+
+/* Finds how many bytes have been written to or read from a stream.
+
+   @param fp is the stream.
+   @return the number of bytes, or UNKNOWN_LEN for a pipe.
+*/
+long streamBytes( FILE *fp );
+
+/* Prints the timings and the context's counts to standard error.
+
+   @param s is the timings of the run.
+   @param z is the context the run used, or NULL if it used several and only
+          the timings are printed.
+*/
+void printStats( Stats const *s, LZW const *z );
+
+#endif
@@ -139,6 +139,131 @@ testInflate() {
   return 0
 }
 
+# Test deflate and inflate together in a pipeline, reading standard input
+# and writing standard output.
+testPipe() {
+  TESTNO=$1
+
+  rm -f output stdout.txt stderr.txt
+
+  echo "pipe test $TESTNO: ./deflate ${args[@]} ${dargs[@]} - - < original-$TESTNO | ./inflate ${args[@]} - - > output 2> stderr.txt"
+  ./deflate ${args[@]} ${dargs[@]} - - < original-$TESTNO 2> stderr.txt | ./inflate ${args[@]} - - > output 2>> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "De-compressed Output" "original-$TESTNO" "output" ||
+     ! checkFileOrEmpty "Error Output" "error-p$TESTNO.txt" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  echo "PASS"
+  return 0
+}
+
+# Test reading part of a block container.  The block container is made
+# with checkpoints every $2 bytes and the range $3:$4 is compared against
+# the same bytes of the original.
+testRange() {
+  TESTNO=$1
+
+  rm -f output expected.txt stderr.txt
+
+  echo "range test $TESTNO: ./deflate --checkpoint $2 original-$TESTNO - | ./inflate --range $3:$4 - output"
+  ./deflate --checkpoint $2 original-$TESTNO - 2> stderr.txt | ./inflate --range $3:$4 - output 2>> stderr.txt
+  ASTATUS=$?
+  tail -c +$(( $3 + 1 )) original-$TESTNO | head -c $4 > expected.txt
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Range Output" "expected.txt" "output" ||
+     ! checkFileOrEmpty "Error Output" "error-r$TESTNO.txt" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  rm -f expected.txt
+  echo "PASS"
+  return 0
+}
+
+# Test compressing and decompressing a batch of files, one run of each
+# program for all of them.  Each original is compared against its copy
+# after going through the batch.
+testBatch() {
+  rm -f manifest-d.txt manifest-i.txt stderr.txt batch-*
+
+  for TESTNO in "$@"; do
+    echo "original-$TESTNO batch-c$TESTNO" >> manifest-d.txt
+    echo "batch-c$TESTNO batch-o$TESTNO" >> manifest-i.txt
+  done
+
+  echo "batch test $*: ./deflate ${args[@]} --batch manifest-d.txt && ./inflate ${args[@]} --batch manifest-i.txt"
+  ./deflate ${args[@]} --batch manifest-d.txt 2> stderr.txt &&
+  ./inflate ${args[@]} --batch manifest-i.txt 2>> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFileOrEmpty "Error Output" "error-b.txt" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  for TESTNO in "$@"; do
+    if ! checkFile "De-compressed Output" "original-$TESTNO" "batch-o$TESTNO"; then
+      FAIL=1
+      return 1
+    fi
+  done
+
+  rm -f manifest-d.txt manifest-i.txt batch-*
+  echo "PASS"
+  return 0
+}
+
+# Test the statistics printed by -s.  The file goes through deflate and
+# inflate with -s, and both should report the same number of codes and
+# bytes of the original.
+testStats() {
+  TESTNO=$1
+
+  rm -f output stats-c stats-d.txt stats-i.txt
+
+  echo "stats test $TESTNO: ./deflate -s ${args[@]} original-$TESTNO stats-c && ./inflate -s ${args[@]} stats-c output"
+  ./deflate -s ${args[@]} original-$TESTNO stats-c 2> stats-d.txt &&
+  ./inflate -s ${args[@]} stats-c output 2> stats-i.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Stats Output" "original-$TESTNO" "output"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  for NAME in codes raw_bytes; do
+    if [ -z "$(grep "^$NAME=" stats-d.txt)" ] ||
+       [ "$(grep "^$NAME=" stats-d.txt)" != "$(grep "^$NAME=" stats-i.txt)" ]
+    then
+      echo "**** FAILED - deflate and inflate report different $NAME"
+      FAIL=1
+      return 1
+    fi
+  done
+
+  if [ "$(grep "^raw_bytes=" stats-d.txt)" != "raw_bytes=$(wc -c < original-$TESTNO)" ]; then
+    echo "**** FAILED - raw_bytes isn't the size of the original"
+    FAIL=1
+    return 1
+  fi
+
+  rm -f stats-c stats-d.txt stats-i.txt
+  echo "PASS"
+  return 0
+}
+
 # make a fresh copy of the target programs
 make clean
 make
@@ -147,6 +272,36 @@ if [ $? -ne 0 ]; then
   FAIL=1
 fi
 
+# Test the buffer functions
+echo
+echo "Testing buffer"
+make bufferTest
+if [ -x bufferTest ] && ./bufferTest; then
+    echo "PASS"
+else
+    echo "**** Test FAILED - bufferTest"
+    FAIL=1
+fi
+
+# Test the library interface
+echo
+echo "Testing library"
+make lzwTest
+if [ -x lzwTest ] && ./lzwTest; then
+    echo "PASS"
+else
+    echo "**** Test FAILED - lzwTest"
+    FAIL=1
+fi
+
+# Only the lzw functions should be exported by the library
+for lib in liblzw.a liblzw.so; do
+  if nm -g --defined-only $lib | grep -v ' lzw' | grep -q ' [A-Z] '; then
+    echo "**** Test FAILED - $lib exports more than the lzw functions"
+    FAIL=1
+  fi
+done
+
 # Test the deflate program
 echo
 echo "Testing deflate"
@@ -186,6 +341,19 @@ if [ -x deflate ]; then
     
     args=(-bad-argument)
     testDeflate 12 1
+    
+    args=(-d)
+    testDeflate 14 0
+    
+    args=(--stream)
+    testDeflate 07 0
+    
+    args=(--stream -b 11)
+    testDeflate 08 0
+    
+    # Inflate can only find the Huffman code in a header
+    args=(--huffman -b 16)
+    testDeflate 18 1
 else
   echo "Since your deflate program didn't compile, we couldn't test it"
 fi
@@ -224,12 +392,139 @@ if [ -x inflate ]; then
     args=()
     testInflate 10 0
     
+    args=(--pipeline)
+    testInflate 12 1
+    
     args=()
     testInflate 13 1
+    
+    args=(-d)
+    testInflate 14 0
+    
+    args=(--stream)
+    testInflate 07 0
+    
+    args=(--stream -b 11)
+    testInflate 08 0
+    
+    args=()
+    testInflate 15 1
+
+    args=()
+    testInflate 16 1
 else
   echo "Since your inflate program didn't compile, we couldn't test it"
 fi
 
+# Test deflate and inflate as a pipeline
+echo
+echo "Testing pipelines"
+if [ -x deflate ] && [ -x inflate ]; then
+    args=(--stream)
+    testPipe 07
+    
+    args=(--stream -b 16)
+    testPipe 10
+    
+    args=(-b 11)
+    testPipe 08
+    
+    args=(-j 4)
+    testPipe 07
+    
+    args=(-j 2 -b 16)
+    testPipe 10
+    
+    args=(-v -b 12)
+    testPipe 07
+    
+    args=(-v -b 9 --stream)
+    testPipe 08
+    
+    args=(-H -b 16)
+    testPipe 07
+    
+    args=(-H -v --stream)
+    testPipe 10
+    
+    args=(-b auto)
+    testPipe 07
+    
+    args=(-v -b auto)
+    testPipe 08
+
+    ./deflate -v -b 14 --train original-07 trained.dict
+    args=(-D trained.dict)
+    testPipe 10
+    
+    args=(-D trained.dict --stream)
+    testPipe 08
+    rm -f trained.dict
+
+    # A trained dictionary's long words let a header claim more bytes than
+    # codes could decode to from single bytes
+    head -c 100000 /dev/zero | tr '\0' a > original-17
+    ./deflate -b 16 --train original-17 trained.dict
+    args=(-D trained.dict -H)
+    testPipe 17
+    rm -f trained.dict original-17
+
+    args=(-b 12 --max-dict-mem 30000)
+    testPipe 07
+
+    args=(-v -b 16 --max-dict-mem 30000 --stream)
+    testPipe 08
+
+    args=(-H -b 14 --max-dict-mem 50000)
+    testPipe 08
+
+    # Options only deflate takes
+    args=()
+    dargs=(--pipeline)
+    testPipe 08
+
+    args=(-H -v -b 14)
+    testPipe 10
+
+    args=(-b 20)
+    testPipe 07
+
+    dargs=(--huffman)
+    args=(-H -b 16)
+    testPipe 07
+
+    args=(-H -v -b 12)
+    testPipe 10
+
+    args=(-H -b 14 --max-dict-mem 30000)
+    testPipe 08
+
+    args=(-H)
+    testPipe 14
+    dargs=()
+
+    testRange 07 10000 45000 30000
+    testRange 07 4096 0 1
+    testRange 08 65536 180000 10000
+
+    args=()
+    testBatch 01 02 07 08 10 14
+
+    args=(-j 3 -H -v -b 14)
+    testBatch 02 07 08 10
+
+    args=(-j 2 -b 12 --max-dict-mem 30000)
+    testBatch 07 08 10
+
+    args=()
+    testStats 07
+
+    args=(-H -b 12 -v --max-dict-mem 30000)
+    testStats 08
+else
+  echo "Since your programs didn't compile, we couldn't test them"
+fi
+
 if [ $FAIL -ne 0 ]; then
   echo "FAILING TESTS!"
   exit 13
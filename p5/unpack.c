@@ -0,0 +1,231 @@
+/**
+   @file unpack.c
+   @author Stephen Gonsalves (dkgonsal)
+
+   The unpack file reads fixed-width codes in batches. Codes are unpacked
+   straight from the bytes they were packed into, several per load, by an
+   AVX2 kernel on processors that have it and by a portable kernel
+   otherwise. The choice is made once, the first time codes are unpacked.
+   The portable kernel has a version for each code width, like the packers.
+*/
+
+#include "unpack.h"
+#include "pack.h"
+
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL
+#endif
+
+/** Bits of a load that are always whole codes, whatever bit it starts on */
+#define LOAD_SPAN ( LOAD_BYTES * BBITS - ( BBITS - 1 ) )
+/** Number of codes the AVX2 kernel unpacks at a time */
+#define AVX2_CODES 8
+/** Widest code the AVX2 kernel can unpack, so each fits in a 32-bit lane
+    whatever bit it starts on */
+#define AVX2_MAX_BITS 25
+
+/** A kernel that unpacks codes, with the same parameters as unpackCodes() */
+typedef int (*Unpacker)( unsigned char const *data, long len, long bitPos, int bits,
+                         unsigned int *codes, int max );
+
+/* Unpacks codes several to a load. Inlined into each width's unpacker with
+   bits as a constant, so a whole load's codes come out of an unrolled loop.
+
+   @param data is the packed codes.
+   @param len is the number of bytes of data.
+   @param bitPos is the position of the first code, in bits from the start of data.
+   @param bits is the number of bits in each code.
+   @param codes is where the codes are stored.
+   @param max is the most codes to unpack.
+   @return the number of codes unpacked.
+*/
+static inline __attribute__(( always_inline ))
+int unpackFixed( unsigned char const *data, long len, long bitPos, int bits,
+                 unsigned int *codes, int max )
+{
+  // Every load holds this many whole codes, whatever bit it starts on
+  int perLoad = LOAD_SPAN / bits;
+  int n = 0;
+
+  while ( n < max && ( bitPos >> 3 ) + LOAD_BYTES <= len ) {
+    unsigned long long w = loadWord( data + ( bitPos >> 3 ) ) << ( bitPos & 7 );
+
+    if ( max - n >= perLoad ) {
+      for ( int i = 0; i < perLoad; i++ ) {
+        codes[ n + i ] = ( unsigned int ) ( ( w << ( i * bits ) ) >> ( 64 - bits ) );
+      }
+      n += perLoad;
+      bitPos += perLoad * bits;
+    } else {
+      while ( n < max ) {
+        codes[ n++ ] = ( unsigned int ) ( w >> ( 64 - bits ) );
+        w <<= bits;
+        bitPos += bits;
+      }
+    }
+  }
+
+  return n;
+}
+
+/** Defines the unpacker for one code width */
+#define UNPACKER( B ) \
+  static int unpack##B( unsigned char const *data, long len, long bitPos, \
+                        unsigned int *codes, int max ) \
+  { return unpackFixed( data, len, bitPos, B, codes, max ); }
+
+UNPACKER( 8 ) UNPACKER( 9 ) UNPACKER( 10 ) UNPACKER( 11 ) UNPACKER( 12 )
+UNPACKER( 13 ) UNPACKER( 14 ) UNPACKER( 15 ) UNPACKER( 16 ) UNPACKER( 17 )
+UNPACKER( 18 ) UNPACKER( 19 ) UNPACKER( 20 ) UNPACKER( 21 ) UNPACKER( 22 )
+UNPACKER( 23 ) UNPACKER( 24 ) UNPACKER( 25 ) UNPACKER( 26 ) UNPACKER( 27 )
+UNPACKER( 28 ) UNPACKER( 29 ) UNPACKER( 30 ) UNPACKER( 31 ) UNPACKER( 32 )
+
+/** Unpacker for one code width */
+typedef int (*WidthUnpacker)( unsigned char const *data, long len, long bitPos,
+                              unsigned int *codes, int max );
+
+/** Unpacker for each code width, starting at PACK_MIN_BITS */
+static WidthUnpacker const unpackers[ PACK_MAX_BITS - PACK_MIN_BITS + 1 ] = {
+  unpack8, unpack9, unpack10, unpack11, unpack12, unpack13, unpack14, unpack15,
+  unpack16, unpack17, unpack18, unpack19, unpack20, unpack21, unpack22, unpack23,
+  unpack24, unpack25, unpack26, unpack27, unpack28, unpack29, unpack30, unpack31,
+  unpack32
+};
+
+int unpackScalar( unsigned char const *data, long len, long bitPos, int bits,
+                  unsigned int *codes, int max )
+{
+  if ( bits < PACK_MIN_BITS || bits > PACK_MAX_BITS ) {
+    return unpackFixed( data, len, bitPos, bits, codes, max );
+  }
+
+  return unpackers[ bits - PACK_MIN_BITS ]( data, len, bitPos, codes, max );
+}
+
+#ifdef HAVE_AVX2_KERNEL
+
+/* Unpacks fixed-width codes eight at a time with AVX2. Eight codes take a
+   whole number of bytes, so every group starts on the same bit of a byte and
+   the byte shuffle and shifts that line up its codes are worked out once.
+   Each 128-bit lane gets its own window of the input, four codes wide, and
+   the shuffle puts each code's bytes into a 32-bit element high-order byte
+   first, so shifting left by its bit offset and right by the width leaves
+   the code. Leaves the last few codes to the portable kernel.
+
+   @param data is the packed codes.
+   @param len is the number of bytes of data.
+   @param bitPos is the position of the first code, in bits from the start of data.
+   @param bits is the number of bits in each code.
+   @param codes is where the codes are stored.
+   @param max is the most codes to unpack.
+   @return the number of codes unpacked.
+*/
+__attribute__(( target( "avx2" ) ))
+static int unpackAVX2( unsigned char const *data, long len, long bitPos, int bits,
+                       unsigned int *codes, int max )
+{
+  if ( bits > AVX2_MAX_BITS ) {
+    return unpackScalar( data, len, bitPos, bits, codes, max );
+  }
+
+  int phase = bitPos & 7;
+  long base = bitPos >> 3;
+
+  // The second window starts at the byte holding the fifth code
+  int half = AVX2_CODES / 2;
+  int hiByte = ( phase + half * bits ) >> 3;
+
+  char shuffle[ 32 ];
+  int shift[ AVX2_CODES ];
+  for ( int i = 0; i < AVX2_CODES; i++ ) {
+    int bit = phase + i * bits - ( i < half ? 0 : hiByte * BBITS );
+    for ( int j = 0; j < 4; j++ ) {
+      shuffle[ i * 4 + j ] = ( char ) ( ( bit >> 3 ) + 3 - j );
+    }
+    shift[ i ] = bit & 7;
+  }
+
+  __m256i control = _mm256_loadu_si256( ( __m256i const * ) shuffle );
+  __m256i left = _mm256_loadu_si256( ( __m256i const * ) shift );
+  __m256i right = _mm256_set1_epi32( 32 - bits );
+  int n = 0;
+
+  while ( n + AVX2_CODES <= max && base + hiByte + 16 <= len ) {
+    __m128i lo = _mm_loadu_si128( ( __m128i const * ) ( data + base ) );
+    __m128i hi = _mm_loadu_si128( ( __m128i const * ) ( data + base + hiByte ) );
+    __m256i v = _mm256_inserti128_si256( _mm256_castsi128_si256( lo ), hi, 1 );
+
+    v = _mm256_shuffle_epi8( v, control );
+    v = _mm256_srlv_epi32( _mm256_sllv_epi32( v, left ), right );
+    _mm256_storeu_si256( ( __m256i * ) ( codes + n ), v );
+
+    n += AVX2_CODES;
+    base += bits;
+  }
+
+  return n + unpackScalar( data, len, bitPos + ( long ) n * bits, bits,
+                           codes + n, max - n );
+}
+
+#endif
+
+/* Picks the fastest kernel this processor can run.
+
+   @return the kernel to unpack codes with.
+*/
+static Unpacker chooseUnpacker()
+{
+#ifdef HAVE_AVX2_KERNEL
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) ) {
+    return unpackAVX2;
+  }
+#endif
+  return unpackScalar;
+}
+
+int unpackCodes( unsigned char const *data, long len, long bitPos, int bits,
+                 unsigned int *codes, int max )
+{
+  // Threads racing here all store the same kernel, so no lock is needed
+  static Unpacker unpacker = NULL;
+  if ( !unpacker ) {
+    unpacker = chooseUnpacker();
+  }
+
+  return unpacker( data, len, bitPos, bits, codes, max );
+}
+
+int readCodes( BitReader *r, unsigned int *codes, int max, int bits )
+{
+  int n = 0;
+
+  while ( n < max ) {
+    // Bits still in the accumulator came from the bytes just before pos,
+    // unless they were carried over from the last chunk
+    long bitPos = ( long ) r->pos * BBITS - r->count;
+    if ( bitPos >= 0 ) {
+      int got = unpackCodes( ( unsigned char const * ) r->buffer->data, r->buffer->len,
+                             bitPos, bits, codes + n, max - n );
+      if ( got > 0 ) {
+        // Leave the reader just past the last code, with the rest of its
+        // byte in the accumulator
+        bitPos += ( long ) got * bits;
+        r->pos = ( bitPos + BBITS - 1 ) / BBITS;
+        r->count = r->pos * BBITS - bitPos;
+        r->acc = r->count ? ( unsigned char ) r->buffer->data[ r->pos - 1 ] : 0;
+        n += got;
+        continue;
+      }
+    }
+
+    // The last few codes in the buffer, and any split across chunks
+    if ( !readCode( r, codes + n, bits ) ) {
+      break;
+    }
+    n++;
+  }
+
+  return n;
+}
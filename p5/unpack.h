@@ -0,0 +1,83 @@
+/**
+   @file unpack.h
+   @author Stephen Gonsalves (dkgonsal)
+
+   The unpack file reads fixed-width codes in batches. Codes are unpacked
+   straight from the bytes they were packed into, several per load, by an
+   AVX2 kernel on processors that have it and by a portable kernel
+   otherwise. The choice is made once, the first time codes are unpacked.
+   The portable kernel has a version for each code width, like the packers.
+*/
+
+#ifndef _UNPACK_H_
+#define _UNPACK_H_
+
+#include "buffer.h"
+
+/** Number of bytes each load of packed codes reads */
+#define LOAD_BYTES 8
+
+/* Reads LOAD_BYTES bytes as one number, high-order byte first.
+
+   @param p is where the bytes start.
+   @return the number they hold.
+*/
+static inline unsigned long long loadWord( unsigned char const *p )
+{
+  unsigned long long w;
+  memcpy( &w, p, sizeof( w ) );
+#if defined( __GNUC__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return __builtin_bswap64( w );
+#elif defined( __GNUC__ ) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return w;
+#else
+  w = 0;
+  for ( int i = 0; i < LOAD_BYTES; i++ ) {
+    w = ( w << BBITS ) | p[ i ];
+  }
+  return w;
+#endif
+}
+
+/* Unpacks fixed-width codes with the portable kernel. Stops before any code
+   whose load would read past the end of the data, so the last few codes are
+   left for the caller.
+
+   @param data is the packed codes.
+   @param len is the number of bytes of data.
+   @param bitPos is the position of the first code, in bits from the start of data.
+   @param bits is the number of bits in each code, at most 32.
+   @param codes is where the codes are stored.
+   @param max is the most codes to unpack.
+   @return the number of codes unpacked.
+*/
+int unpackScalar( unsigned char const *data, long len, long bitPos, int bits,
+                  unsigned int *codes, int max );
+
+/* Unpacks fixed-width codes with the fastest kernel this processor has.
+   Stops before any code whose load would read past the end of the data, so
+   the last few codes are left for the caller.
+
+   @param data is the packed codes.
+   @param len is the number of bytes of data.
+   @param bitPos is the position of the first code, in bits from the start of data.
+   @param bits is the number of bits in each code, at most 32.
+   @param codes is where the codes are stored.
+   @param max is the most codes to unpack.
+   @return the number of codes unpacked.
+*/
+int unpackCodes( unsigned char const *data, long len, long bitPos, int bits,
+                 unsigned int *codes, int max );
+
+/* Reads a batch of codes that all have the same width. Gives the same codes
+   as calling readCode() for each, but unpacks most of them in bulk.
+
+   @param r is the bit reader supplying the codes.
+   @param codes is where the codes are stored.
+   @param max is the most codes to read.
+   @param bits is the number of bits in each code, at most 32.
+   @return the number of codes read, less than max only at the end of the input.
+*/
+int readCodes( BitReader *r, unsigned int *codes, int max, int bits );
+
+#endif